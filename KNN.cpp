@@ -1,4 +1,5 @@
 #include "KNN.h"
+#include "binary_io.h"
 
 double euclidean_distance_mesure(Dataset *self, const vector<Dataset::DataType> &_a, const vector<Dataset::DataType> &_b)
 {
@@ -42,42 +43,217 @@ double euclidean_distance_mesure(Dataset *self, const vector<Dataset::DataType>
 
 KNN::KNN(
     const string &path, const string &label, int k,
-    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), bool deduplicate)
 {
     _proximity_measure = proximity_measure;
     _k = k;
-    dataset = Dataset::read_csv(path);
-    dataset.normalize();
+    _deduplicate = deduplicate;
+    Dataset dataset = Dataset::read_csv(path);
     dataset.set_label(label);
+    publish(dataset);
 }
 
 Dataset::DataType KNN::predict(const vector<Dataset::DataType> &sample)
 {
-    auto _k_nn = first_knn(sample);
-    auto keys = dataset.get_attributes();
+    return predict(sample, 0);
+}
+
+Dataset::DataType KNN::predict(const vector<Dataset::DataType> &sample, unsigned int nprobe)
+{
+    auto current = snapshot();
+    auto &dataset = *current->dataset;
+    vector<pair<double, int>> _k_nn;
+    ClassPrefilter::Result filtered;
+    if (current->prefilter and dataset.get_label().length())
+    {
+        auto _target = sample;
+        if (dataset.is_normalized(_target))
+            dataset.renormalize(_target);
+        filtered = current->prefilter->filter(dataset, _target, _k);
+        // the decision only covers the training set, an inserted row may be nearer than the margin.
+        if (filtered.decided and current->delta_rows() == 0)
+            return filtered.label;
+        if (filtered.restricted)
+            _k_nn = candidate_knn(*current, _target, filtered.candidates, _k);
+    }
+    if (not filtered.restricted)
+        _k_nn = first_knn(*current, sample, _k, [](double a, double b)
+                          { return a <= b; }, nprobe);
 
+    return vote(neighbour_labels(*current, _k_nn, _k));
+}
+
+vector<Dataset::DataType> KNN::predict_multi_k(const vector<Dataset::DataType> &sample, const vector<unsigned int> &ks, unsigned int nprobe)
+{
+    vector<Dataset::DataType> res(ks.size());
+    if (ks.empty())
+        return res;
+    if (find(ks.begin(), ks.end(), 0u) != ks.end())
+        throw invalid_argument("k should be > 0.\n");
+
+    unsigned int k = *max_element(ks.begin(), ks.end());
+    auto current = snapshot();
+    auto &dataset = *current->dataset;
+    vector<pair<double, int>> _k_nn;
+    ClassPrefilter::Result filtered;
+    if (current->prefilter and dataset.get_label().length())
+    {
+        auto _target = sample;
+        if (dataset.is_normalized(_target))
+            dataset.renormalize(_target);
+        // the decision does not depend on k, and candidates enough for the largest k are enough for all.
+        filtered = current->prefilter->filter(dataset, _target, k);
+        if (filtered.decided and current->delta_rows() == 0)
+            return vector<Dataset::DataType>(ks.size(), filtered.label);
+        if (filtered.restricted)
+            _k_nn = candidate_knn(*current, _target, filtered.candidates, k);
+    }
+    if (not filtered.restricted)
+        _k_nn = first_knn(*current, sample, k, [](double a, double b)
+                          { return a <= b; }, nprobe);
+
+    auto neighbours = neighbour_labels(*current, _k_nn, k);
+    if (neighbours.empty())
+    {
+        cerr << " no neighbors to vote, an empty label returned.\n";
+        return res;
+    }
+
+    vector<size_t> order(ks.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t a, size_t b)
+         { return ks[a] < ks[b]; });
+
+    // weights only grow, so the leader changes only when the label just voted for overtakes it.
     unordered_map<Dataset::DataType, double> weights;
-    int l = 0;
+    Dataset::DataType leader = neighbours.front().second;
+    size_t next = 0;
+    for (size_t i = 0; i < neighbours.size() and next < order.size(); i++)
+    {
+        for (; next < order.size() and ks[order[next]] == i; next++)
+        {
+            res[order[next]] = i ? leader : Dataset::DataType{};
+        }
+        double &weight = weights[neighbours[i].second];
+        weight += exp(-neighbours[i].first);
+        if (weight > weights[leader])
+            leader = neighbours[i].second;
+    }
+    // the requested k beyond the neighbors found get all of them.
+    for (; next < order.size(); next++)
+    {
+        res[order[next]] = leader;
+    }
+    return res;
+}
 
-    for (size_t i = 0; i < keys.size(); i++)
+vector<pair<double, Dataset::DataType>> KNN::neighbour_labels(Snapshot &snapshot, const vector<pair<double, int>> &neighbours, unsigned int k)
+{
+    vector<pair<double, Dataset::DataType>> res;
+    if (neighbours.empty())
+        return res;
+
+    auto &dataset = *snapshot.dataset;
+    for (auto &&i : neighbours)
     {
-        if (dataset.get_label() == keys[i])
+        if (snapshot.multiplicities and i.second < dataset.no_rows())
         {
-            l = i;
-            break;
+            // one vote per copy, the copies beyond the k-th excepted.
+            for (auto &&j : (*snapshot.multiplicities)[i.second])
+            {
+                for (int c = 0; c < j.second and res.size() < k; c++)
+                {
+                    res.push_back(make_pair(i.first, j.first));
+                }
+            }
+        }
+        else if (res.size() < k)
+        {
+            auto at = snapshot.locate(i.second);
+            res.push_back(make_pair(i.first, (*at.first)[dataset.get_label()][at.second]));
         }
     }
+    return res;
+}
+
+shared_ptr<const vector<KNN::LabelCounts>> KNN::deduplicate(Dataset &dataset, const vector<LabelCounts> *multiplicities, vector<int> &stored_at)
+{
+    auto keys = dataset.get_attributes();
+    int l = find(keys.begin(), keys.end(), dataset.get_label()) - keys.begin();
+    auto hash = [](const vector<Dataset::DataType> &row)
+    {
+        size_t seed = row.size();
+        for (auto &&i : row)
+        {
+            seed ^= std::hash<Dataset::DataType>()(i) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    };
+    unordered_map<vector<Dataset::DataType>, int, decltype(hash)> stored(dataset.no_rows(), hash);
 
+    Dataset unique = dataset.structure();
+    auto counts = make_shared<vector<LabelCounts>>();
+    stored_at.clear();
+    for (int i = 0; i < dataset.no_rows(); i++)
+    {
+        auto row = dataset.iterrow(i);
+        auto features = row;
+        features.erase(features.begin() + l);
+        LabelCounts copies = multiplicities ? (*multiplicities)[i] : LabelCounts{};
+        if (copies.empty())
+            copies.push_back(make_pair(row[l], 1));
+
+        auto at = stored.insert(make_pair(move(features), unique.no_rows()));
+        stored_at.push_back(at.first->second);
+        if (at.second)
+        {
+            unique.push_back(row);
+            counts->push_back(move(copies));
+            continue;
+        }
+
+        auto &merged = (*counts)[at.first->second];
+        for (auto &&j : copies)
+        {
+            auto same = find_if(merged.begin(), merged.end(), [&](const pair<Dataset::DataType, int> &c)
+                                { return c.first == j.first; });
+            if (same == merged.end())
+                merged.push_back(j);
+            else
+                same->second += j.second;
+        }
+    }
+
+    // the most frequent labels first, so they get the votes of a row cut short by k.
+    for (auto &&i : *counts)
+    {
+        stable_sort(i.begin(), i.end(), [](const pair<Dataset::DataType, int> &a, const pair<Dataset::DataType, int> &b)
+                    { return a.second > b.second; });
+    }
+
+    dataset = move(unique);
+    return counts;
+}
+
+Dataset::DataType KNN::vote(const vector<pair<double, Dataset::DataType>> &neighbours)
+{
+    if (neighbours.empty())
+    {
+        cerr << " no neighbors to vote, an empty label returned.\n";
+        return {};
+    }
+
+    unordered_map<Dataset::DataType, double> weights;
     double sum = 0.0;
 
-    for (auto &&i : _k_nn)
+    for (auto &&i : neighbours)
     {
         sum += exp(-i.first);
     }
 
-    for (auto &&i : _k_nn)
+    for (auto &&i : neighbours)
     {
-        weights[dataset.iterrow(i.second)[l]] += exp(-i.first) / sum;
+        weights[i.second] += exp(-i.first) / sum;
     }
 
     pair<Dataset::DataType, double>  max_element = *weights.begin();
@@ -94,8 +270,17 @@ Dataset::DataType KNN::predict(const vector<Dataset::DataType> &sample)
 }
 
 unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> KNN::evaluate(Dataset &testData)
+{
+    auto confusion_matrix = classify(testData);
+    report(confusion_matrix);
+    return confusion_matrix;
+}
+
+unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> KNN::classify(Dataset &testData)
 {
     unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> confusion_matrix;
+    auto current = snapshot();
+    auto &dataset = *current->dataset;
 
     int l = 0;
     for (size_t i = 0; i < dataset.get_attributes().size(); i++)
@@ -107,62 +292,57 @@ unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> KNN::eva
         }
     }
 
+    vector<vector<pair<double, int>>> _k_nn;
+    if (dual_tree_knn(*current, testData, _k, _k_nn))
+    {
+        auto &actual = testData[dataset.get_label()];
+        for (int i = 0; i < testData.no_rows(); i++)
+        {
+            ++confusion_matrix[actual[i]][vote(neighbour_labels(*current, _k_nn[i], _k))];
+        }
+        return confusion_matrix;
+    }
+
     for (size_t i = 0; i < testData.no_rows(); i++)
     {
         auto _actual = testData.iterrow(i)[l];
         auto _predicted = predict(testData.iterrow(i));
         ++confusion_matrix[_actual][_predicted];
     }
-    unordered_map<string, vector<double>> confusion_matrix_elements;
-
-    double TN = 0.0;
-    for (auto &&i : confusion_matrix)
-    {
-        for (auto &&j : i.second)
-        {
-            if (i.first == j.first)
-            {
-                confusion_matrix_elements["TP"].push_back(j.second);
-                TN += j.second;
-            }
-            else
-            {
-                confusion_matrix_elements["FN"].push_back(j.second);
-                confusion_matrix_elements["FP"].push_back(j.second);
-            }
-            TN += j.second;
-        }
-    }
-
-    double TP = accumulate(confusion_matrix_elements["TP"].begin(), confusion_matrix_elements["TP"].end(), 0.0),
-           FN = accumulate(confusion_matrix_elements["FN"].begin(), confusion_matrix_elements["FN"].end(), 0.0),
-           FP = accumulate(confusion_matrix_elements["FP"].begin(), confusion_matrix_elements["FP"].end(), 0.0);
-
-    std::cout << "\nModel Micro-Precision : " << (int)round((TP / (TP + FP)) * 100) << "%"
-         << "\nModel Micro-Recall    : " << (int)round((TP / (TP + FN)) * 100) << "%"
-         << "\nModel Micro-Accuracy  : " << (int)round(((TP + TN) / (TP + TN + FP + FN)) * 100) << "%\n"
-         << endl;
 
     return confusion_matrix;
 }
 
-KNN::KNN(const Dataset &train_dataset, int k, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+KNN::KNN(const Dataset &train_dataset, int k, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &),
+         bool deduplicate)
 {
     _proximity_measure = proximity_measure;
-    dataset = move(train_dataset);
     _k = k;
-    dataset.normalize();
-    dataset.set_label(dataset.get_label());
+    _deduplicate = deduplicate;
+    publish(train_dataset);
 }
 
 void KNN::set_proximity_measure(double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
 {
+    lock_guard<mutex> lock(_writer);
     _proximity_measure = proximity_measure;
+    if (_index)
+        republish_index();
+}
+
+vector<pair<double, int>> KNN::first_knn(
+    const vector<Dataset::DataType> &target, bool (*comparison_fn)(double, double), unsigned int nprobe)
+{
+    return first_knn(*snapshot(), target, _k, comparison_fn, nprobe);
 }
 
 vector<pair<double, int>> KNN::first_knn(
-    const vector<Dataset::DataType> &target, bool (*comparison_fn)(double, double))
+    Snapshot &snapshot, const vector<Dataset::DataType> &target, unsigned int k, bool (*comparison_fn)(double, double), unsigned int nprobe)
 {
+    auto &dataset = *snapshot.dataset;
+    auto proximity_measure = _proximity_measure.load();
+    k = min<unsigned int>(k, snapshot.no_rows() - snapshot.tombstones.size());
+
     if (dataset.get_label().length() == 0)
     {
         cerr << " label unset, an empty vector returned.\n";
@@ -175,26 +355,606 @@ vector<pair<double, int>> KNN::first_knn(
 
     vector<pair<double, int>> proxi_measure_res;
 
-    for (size_t i = 0; i < dataset.no_rows(); i++)
+    if (snapshot.index)
+    {
+        // over-fetch by the erased rows, which the index still holds.
+        for (auto &&i : snapshot.index->search(dataset, _target, k + snapshot.tombstones.size(), proximity_measure, nprobe))
+        {
+            if (not snapshot.tombstones.count(i.second))
+                proxi_measure_res.push_back(i);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < dataset.no_rows(); i++)
+        {
+            if (snapshot.tombstones.count(i))
+                continue;
+            auto _ = dataset.iterrow(i);
+            proxi_measure_res.push_back(make_pair(proximity_measure(&dataset, _, _target), i));
+        }
+    }
+
+    for (int i = dataset.no_rows(); i < snapshot.no_rows(); i++)
     {
-        auto _ = dataset.iterrow(i);
-        proxi_measure_res.push_back(make_pair(_proximity_measure(&dataset, _, _target), i));
+        if (snapshot.tombstones.count(i))
+            continue;
+        auto at = snapshot.locate(i);
+        auto _ = at.first->iterrow(at.second);
+        proxi_measure_res.push_back(make_pair(proximity_measure(at.first, _, _target), i));
     }
 
-    partial_sort(proxi_measure_res.begin(), proxi_measure_res.begin() + _k, proxi_measure_res.end(), [&](const pair<double, int> &a, const pair<double, int> &b)
+    k = min<size_t>(k, proxi_measure_res.size());
+    partial_sort(proxi_measure_res.begin(), proxi_measure_res.begin() + k, proxi_measure_res.end(), [&](const pair<double, int> &a, const pair<double, int> &b)
                  { return comparison_fn(a.first, b.first); });
 
-    return vector<pair<double, int>>(proxi_measure_res.begin(), proxi_measure_res.begin() + _k);
+    return vector<pair<double, int>>(proxi_measure_res.begin(), proxi_measure_res.begin() + k);
+}
+
+KNNGraph KNN::knn_graph(unsigned int k)
+{
+    compact();
+    auto current = snapshot();
+    KNNGraph graph(k);
+    graph.build(*current->dataset, _proximity_measure);
+    return graph;
+}
+
+bool KNN::dual_tree_knn(Snapshot &snapshot, Dataset &rows, unsigned int k, vector<vector<pair<double, int>>> &neighbours)
+{
+    auto &dataset = *snapshot.dataset;
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    if (_proximity_measure != euclidean_distance_mesure or dataset.get_label().empty() or rows.get_attributes() != keys)
+        return false;
+    // the neighbors predict would find and vote with.
+    if ((snapshot.index and not snapshot.index->exact()) or snapshot.prefilter)
+        return false;
+
+    vector<int> attributes;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == dataset.get_label())
+            continue;
+        if (find(numerics.begin(), numerics.end(), keys[i]) == numerics.end())
+            return false;
+        attributes.push_back(i);
+    }
+    if (attributes.empty())
+        return false;
+
+    // the live rows of the snapshot, the delta included.
+    size_t dim = attributes.size();
+    vector<int> live;
+    for (int i = 0; i < snapshot.no_rows(); i++)
+    {
+        if (not snapshot.tombstones.count(i))
+            live.push_back(i);
+    }
+    vector<float> references(live.size() * dim);
+    for (size_t j = 0; j < dim; j++)
+    {
+        auto &values = dataset[keys[attributes[j]]];
+        for (size_t i = 0; i < live.size(); i++)
+        {
+            if (live[i] < dataset.no_rows())
+                references[i * dim + j] = get<double>(values[live[i]]);
+            else
+            {
+                auto at = snapshot.locate(live[i]);
+                references[i * dim + j] = get<double>((*at.first)[keys[attributes[j]]][at.second]);
+            }
+        }
+    }
+
+    vector<float> queries;
+    for (int i = 0; i < rows.no_rows(); i++)
+    {
+        auto row = rows.iterrow(i);
+        if (dataset.is_normalized(row))
+            dataset.renormalize(row);
+        for (auto &&j : attributes)
+        {
+            queries.push_back(get<double>(row[j]));
+        }
+    }
+
+    KDTree tree(references.data(), live.size(), dim);
+    auto found = tree.knn(KDTree(queries.data(), rows.no_rows(), dim), k);
+    neighbours.assign(found.size(), {});
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        for (auto &&j : found[i])
+        {
+            neighbours[i].push_back(make_pair(sqrt(j.first), live[j.second]));
+        }
+    }
+    return true;
+}
+
+double KNN::reduce(PrototypeSelection selection, Dataset *validation)
+{
+    auto accuracy = [&]()
+    {
+        double correct = 0, total = 0;
+        for (auto &&i : classify(*validation))
+        {
+            for (auto &&j : i.second)
+            {
+                correct += i.first == j.first ? j.second : 0;
+                total += j.second;
+            }
+        }
+        return total ? correct / total : 0.0;
+    };
+
+    double accuracy_before = validation ? accuracy() : 0;
+    int before, after;
+    {
+        lock_guard<mutex> lock(_writer);
+        compact_locked();
+        auto current = snapshot();
+        auto &dataset = *current->dataset;
+        auto proximity_measure = _proximity_measure.load();
+        before = dataset.no_rows();
+
+        auto multiplicities = current->multiplicities.get();
+        vector<int> kept;
+        if (selection == PrototypeSelection::condensed)
+            kept = condensed_nearest_neighbor(dataset, proximity_measure, multiplicities);
+        else if (selection == PrototypeSelection::fast_condensed)
+            kept = fast_condensed_nearest_neighbor(dataset, proximity_measure, 0, multiplicities);
+        else if (selection == PrototypeSelection::edited)
+            kept = edited_nearest_neighbor(dataset, proximity_measure, 3, 0, multiplicities);
+        else
+            kept = fast_edited_nearest_neighbor(dataset, proximity_measure, 3, multiplicities);
+        after = kept.size();
+
+        auto next = make_shared<Snapshot>();
+        next->dataset = make_shared<Dataset>(dataset);
+        auto counts = current->multiplicities ? make_shared<vector<LabelCounts>>(*current->multiplicities) : nullptr;
+        vector<int> origin(before);
+        iota(origin.begin(), origin.end(), 0);
+        // descending order, so the last row swapped into a removed slot is always a kept one.
+        for (int i = before - 1, j = after - 1; i >= 0; i--)
+        {
+            if (j >= 0 and kept[j] == i)
+                j--;
+            else
+            {
+                next->dataset->remove(i);
+                swap(origin[i], origin.back());
+                origin.pop_back();
+                if (counts)
+                {
+                    swap((*counts)[i], counts->back());
+                    counts->pop_back();
+                }
+            }
+        }
+        vector<int> moved(before, -1);
+        for (size_t i = 0; i < origin.size(); i++)
+        {
+            moved[origin[i]] = i;
+        }
+        next->ids = move_rows(moved, after);
+        next->multiplicities = counts;
+        next->index = build_index(*next->dataset);
+        next->prefilter = build_prefilter(*next->dataset);
+        atomic_store(&_snapshot, next);
+    }
+
+    double compression = after ? (double)before / after : 0;
+    cout << "\nRows kept             : " << after << " / " << before
+         << "\nCompression ratio     : " << compression << "x\n";
+    if (validation)
+    {
+        double accuracy_after = accuracy();
+        cout << "Accuracy before       : " << accuracy_before * 100 << "%"
+             << "\nAccuracy after        : " << accuracy_after * 100 << "%"
+             << "\nAccuracy delta        : " << (accuracy_after - accuracy_before) * 100 << "%\n";
+    }
+    cout << endl;
+    return compression;
+}
+
+vector<pair<double, int>> KNN::candidate_knn(Snapshot &snapshot, const vector<Dataset::DataType> &target, const vector<int> &candidates, unsigned int k)
+{
+    auto &dataset = *snapshot.dataset;
+    auto proximity_measure = _proximity_measure.load();
+    vector<pair<double, int>> proxi_measure_res;
+
+    for (auto &&i : candidates)
+    {
+        if (not snapshot.tombstones.count(i))
+            proxi_measure_res.push_back(make_pair(proximity_measure(&dataset, dataset.iterrow(i), target), i));
+    }
+    for (int i = dataset.no_rows(); i < snapshot.no_rows(); i++)
+    {
+        auto at = snapshot.locate(i);
+        if (not snapshot.tombstones.count(i))
+            proxi_measure_res.push_back(make_pair(proximity_measure(at.first, at.first->iterrow(at.second), target), i));
+    }
+
+    k = min<size_t>(k, proxi_measure_res.size());
+    partial_sort(proxi_measure_res.begin(), proxi_measure_res.begin() + k, proxi_measure_res.end());
+    proxi_measure_res.resize(k);
+    return proxi_measure_res;
 }
 
 void KNN::set_dataset(const string &path)
 {
-    dataset = Dataset::read_csv(path);
+    Dataset dataset = Dataset::read_csv(path);
+    auto current = snapshot();
+
+    try
+    {
+        if (current)
+        {
+            dataset.set_label(current->dataset->get_label());
+        }
+    }
+    catch (const char *e)
+    {
+        cerr << e;
+    }
+
+    publish(dataset);
+}
+
+void KNN::publish(const Dataset &dataset)
+{
+    // the snapshot is built aside, readers are never blocked.
+    lock_guard<mutex> lock(_writer);
+    auto next = make_shared<Snapshot>();
+    next->dataset = make_shared<Dataset>(dataset);
+    next->dataset->normalize();
+    int rows = next->dataset->no_rows();
+    vector<int> stored_at;
+    if (_deduplicate)
+        next->multiplicities = deduplicate(*next->dataset, nullptr, stored_at);
+    next->ids = number_rows(rows, stored_at, next->dataset->no_rows());
+    next->index = build_index(*next->dataset);
+    next->prefilter = build_prefilter(*next->dataset);
+
+    _bounds.clear();
+    atomic_store(&_snapshot, next);
+}
+
+void KNN::set_index(shared_ptr<SearchIndex> index)
+{
+    lock_guard<mutex> lock(_writer);
+    _index = index;
+    republish_index();
+}
+
+void KNN::set_prefilter(shared_ptr<ClassPrefilter> prefilter)
+{
+    lock_guard<mutex> lock(_writer);
+    _prefilter = prefilter;
+    republish_index();
+}
+
+shared_ptr<SearchIndex> KNN::get_index() const
+{
+    return snapshot()->index;
+}
+
+shared_ptr<SearchIndex> KNN::build_index(Dataset &dataset)
+{
+    if (not _index)
+        return nullptr;
+
+    auto index = _index->clone();
+    index->build(dataset, _proximity_measure);
+    return index;
+}
+
+shared_ptr<ClassPrefilter> KNN::build_prefilter(Dataset &dataset)
+{
+    if (not _prefilter)
+        return nullptr;
+
+    auto prefilter = _prefilter->clone();
+    prefilter->build(dataset);
+    return prefilter;
+}
+
+void KNN::republish_index()
+{
+    auto current = snapshot();
+    if (not current)
+        return;
+
+    auto next = make_shared<Snapshot>(*current);
+    next->index = build_index(*next->dataset);
+    next->prefilter = build_prefilter(*next->dataset);
+    atomic_store(&_snapshot, next);
+}
+
+KNN::RowId KNN::insert(const vector<Dataset::DataType> &row)
+{
+    return insert(vector<vector<Dataset::DataType>>{row}).front();
+}
+
+vector<KNN::RowId> KNN::insert(const vector<vector<Dataset::DataType>> &rows)
+{
+    unique_lock<mutex> lock(_writer);
+    auto current = snapshot();
+    auto &dataset = *current->dataset;
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    auto block = make_shared<DeltaBlock>();
+    block->rows = dataset.structure();
+
+    for (auto row : rows)
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (find(numerics.begin(), numerics.end(), keys[i]) == numerics.end())
+                continue;
+
+            double value = get<double>(row[i]);
+            auto bounds = _bounds.find(keys[i]);
+            if (bounds == _bounds.end())
+            {
+                bounds = _bounds.insert(make_pair(keys[i], make_pair(get<double>(dataset.local_parms.at(keys[i] + " nmin")),
+                                                                     get<double>(dataset.local_parms.at(keys[i] + " nmax")))))
+                             .first;
+            }
+            bounds->second.first = min(bounds->second.first, value);
+            bounds->second.second = max(bounds->second.second, value);
+        }
+        block->rows.renormalize(row);
+        block->rows.push_back(row);
+        _positions[_next_id] = current->no_rows() + block->ids.size();
+        block->ids.push_back(_next_id++);
+    }
+    auto ids = block->ids;
+
+    // the block absorbs the blocks before it that are not larger; a row is copied again only when its block
+    // at least doubles, so a logarithmic number of times.
+    auto delta = current->delta;
+    while (not delta.empty() and delta.back()->rows.no_rows() <= block->rows.no_rows())
+    {
+        auto merged = make_shared<DeltaBlock>(*delta.back());
+        for (int i = 0; i < block->rows.no_rows(); i++)
+        {
+            merged->rows.push_back(block->rows.iterrow(i));
+        }
+        merged->ids.insert(merged->ids.end(), block->ids.begin(), block->ids.end());
+        block = merged;
+        delta.pop_back();
+    }
+    delta.push_back(block);
+
+    publish_changes(move(delta), current->tombstones);
+    return ids;
+}
+
+void KNN::erase(RowId id)
+{
+    unique_lock<mutex> lock(_writer);
+    auto current = snapshot();
+
+    auto at = _positions.find(id);
+    if (at == _positions.end() or current->tombstones.count(at->second))
+        throw range_error("no such row.\n");
+
+    auto tombstones = current->tombstones;
+    tombstones.insert(at->second);
+    _positions.erase(at);
+    publish_changes(current->delta, move(tombstones));
+}
+
+shared_ptr<const vector<KNN::RowId>> KNN::move_rows(const vector<int> &moved, int rows)
+{
+    auto ids = make_shared<vector<RowId>>(rows, -1);
+    for (auto i = _positions.begin(); i != _positions.end();)
+    {
+        int at = moved[i->second];
+        if (at < 0)
+        {
+            i = _positions.erase(i);
+            continue;
+        }
+        i->second = at;
+        if ((*ids)[at] < 0 or i->first < (*ids)[at])
+            (*ids)[at] = i->first;
+        ++i;
+    }
+    return ids;
+}
+
+shared_ptr<const vector<KNN::RowId>> KNN::number_rows(int rows, const vector<int> &stored_at, int kept)
+{
+    _positions.clear();
+    vector<int> moved(rows);
+    for (int i = 0; i < rows; i++)
+    {
+        _positions[_next_id++] = i;
+        moved[i] = stored_at.empty() ? i : stored_at[i];
+    }
+    return move_rows(moved, kept);
+}
+
+void KNN::publish_changes(vector<shared_ptr<DeltaBlock>> delta, unordered_set<int> tombstones)
+{
+    auto current = snapshot();
+    auto next = make_shared<Snapshot>();
+    next->dataset = current->dataset;
+    next->ids = current->ids;
+    next->index = current->index;
+    next->prefilter = current->prefilter;
+    next->multiplicities = current->multiplicities;
+    next->delta = move(delta);
+    next->tombstones = move(tombstones);
+    atomic_store(&_snapshot, next);
+
+    if (next->delta_rows() + next->tombstones.size() < _compaction_threshold or _compacting)
+        return;
+
+    // the previous compaction, if any, has already released the writer lock.
+    if (_compactor.joinable())
+        _compactor.join();
+
+    _compacting = true;
+    _compactor = thread([this]()
+                        {
+                            {
+                                lock_guard<mutex> lock(_writer);
+                                compact_locked();
+                            }
+                            _compacting = false; });
+}
+
+void KNN::compact()
+{
+    lock_guard<mutex> lock(_writer);
+    compact_locked();
+}
+
+void KNN::compact_locked()
+{
+    auto current = snapshot();
+    if (current->delta.empty() and current->tombstones.empty() and _bounds.empty())
+        return;
+
+    auto next = make_shared<Snapshot>();
+    next->dataset = make_shared<Dataset>(*current->dataset);
+    auto &dataset = *next->dataset;
+    int size = dataset.no_rows();
+    bool deduplicated = current->multiplicities or _deduplicate;
+    vector<LabelCounts> multiplicities;
+    if (current->multiplicities)
+        multiplicities = *current->multiplicities;
+    multiplicities.resize(deduplicated ? size : 0);
+    // the position in the current snapshot of every compacted row.
+    vector<int> origin(size);
+    iota(origin.begin(), origin.end(), 0);
+
+    vector<int> erased(current->tombstones.begin(), current->tombstones.end());
+    sort(erased.begin(), erased.end(), greater<int>());
+
+    // descending order, so the last row swapped into a removed slot is always a live one.
+    for (auto &&i : erased)
+    {
+        if (i < size)
+        {
+            dataset.remove(i);
+            swap(origin[i], origin.back());
+            origin.pop_back();
+            if (deduplicated)
+            {
+                swap(multiplicities[i], multiplicities.back());
+                multiplicities.pop_back();
+            }
+        }
+    }
+
+    for (int i = size; i < current->no_rows(); i++)
+    {
+        if (not current->tombstones.count(i))
+        {
+            dataset.push_back(current->iterrow(i));
+            origin.push_back(i);
+            if (deduplicated)
+                multiplicities.emplace_back();
+        }
+    }
+
+    for (auto &&i : _bounds)
+    {
+        if (i.second.first != get<double>(dataset.local_parms.at(i.first + " nmin")) or
+            i.second.second != get<double>(dataset.local_parms.at(i.first + " nmax")))
+            dataset.rescale(i.first, i.second.first, i.second.second);
+    }
+    _bounds.clear();
+    // inserted rows may repeat stored ones.
+    vector<int> stored_at;
+    if (deduplicated)
+        next->multiplicities = deduplicate(dataset, &multiplicities, stored_at);
+    vector<int> moved(current->no_rows(), -1);
+    for (size_t i = 0; i < origin.size(); i++)
+    {
+        moved[origin[i]] = stored_at.empty() ? i : stored_at[i];
+    }
+    next->ids = move_rows(moved, dataset.no_rows());
+
+    next->index = build_index(dataset);
+    next->prefilter = build_prefilter(dataset);
+    atomic_store(&_snapshot, next);
+}
+
+void KNN::set_compaction_threshold(unsigned int threshold)
+{
+    lock_guard<mutex> lock(_writer);
+    _compaction_threshold = threshold;
+}
+
+KNN::~KNN()
+{
+    if (_compactor.joinable())
+        _compactor.join();
+}
+
+vector<Dataset::DataType> KNN::Snapshot::iterrow(int at) const
+{
+    auto row = locate(at);
+    return row.first->iterrow(row.second);
+}
+
+pair<Dataset *, int> KNN::Snapshot::locate(int at) const
+{
+    if (at < dataset->no_rows())
+        return make_pair(dataset.get(), at);
+    at -= dataset->no_rows();
+    for (auto &&i : delta)
+    {
+        if (at < i->rows.no_rows())
+            return make_pair(&i->rows, at);
+        at -= i->rows.no_rows();
+    }
+    throw range_error("index out of range.\n");
+}
+
+KNN::RowId KNN::Snapshot::id(int at) const
+{
+    if (at < dataset->no_rows())
+        return (*ids)[at];
+    at -= dataset->no_rows();
+    for (auto &&i : delta)
+    {
+        if (at < i->rows.no_rows())
+            return i->ids[at];
+        at -= i->rows.no_rows();
+    }
+    throw range_error("index out of range.\n");
+}
+
+int KNN::Snapshot::no_rows() const
+{
+    return dataset->no_rows() + delta_rows();
+}
+
+int KNN::Snapshot::delta_rows() const
+{
+    int rows = 0;
+    for (auto &&i : delta)
+    {
+        rows += i->rows.no_rows();
+    }
+    return rows;
+}
+
+shared_ptr<KNN::Snapshot> KNN::snapshot() const
+{
+    return atomic_load(&_snapshot);
 }
 
 Dataset &KNN::get_dataset()
 {
-    return dataset;
+    return *snapshot()->dataset;
 }
 
 void KNN::set_k(unsigned int k)
@@ -207,12 +967,107 @@ unsigned int KNN::get_k()const
     return _k;
 }
 
-void KNN::saveModel(const string&)
+void KNN::saveModel(const string &filePath)
 {
+    compact();
+    auto current = snapshot();
+    current->dataset->save_binary(filePath);
+
+    string index_path = filePath + ".index";
+    ofstream index(index_path, ios::binary | ios::out | ios::trunc);
+    if (not current->index or not current->index->save(index))
+    {
+        index.close();
+        remove(index_path.c_str());
+    }
+
+    string counts_path = filePath + ".counts";
+    if (not current->multiplicities)
+    {
+        remove(counts_path.c_str());
+        return;
+    }
+    ofstream counts(counts_path, ios::binary | ios::out | ios::trunc);
+    write_pod<uint64_t>(counts, current->multiplicities->size());
+    for (auto &&i : *current->multiplicities)
+    {
+        write_pod<uint32_t>(counts, i.size());
+        for (auto &&j : i)
+        {
+            // a tag, 0 for a number and 1 for a string, then the value and its count.
+            write_pod<uint8_t>(counts, j.first.index());
+            if (holds_alternative<double>(j.first))
+                write_pod<double>(counts, get<double>(j.first));
+            else
+                write_string(counts, get<string>(j.first));
+            write_pod<int32_t>(counts, j.second);
+        }
+    }
 }
 
-void KNN::loadModel(const string&)
+void KNN::loadModel(const string &filePath)
 {
+    Dataset dataset = Dataset::load_binary(filePath);
+    if (dataset.get_attributes().empty())
+        return;
+
+    lock_guard<mutex> lock(_writer);
+    auto next = make_shared<Snapshot>();
+    next->dataset = make_shared<Dataset>(dataset);
+    next->dataset->normalize();
+
+    ifstream counts(filePath + ".counts", ios::binary | ios::in);
+    if (counts.is_open())
+    {
+        counts.seekg(0, ios::end);
+        uint64_t size = counts.tellg();
+        counts.seekg(0);
+        auto multiplicities = make_shared<vector<LabelCounts>>();
+        if (read_pod<uint64_t>(counts) == uint64_t(next->dataset->no_rows()))
+            multiplicities->resize(next->dataset->no_rows());
+        for (auto &&i : *multiplicities)
+        {
+            // a label takes at least a tag, a string length and a count.
+            uint32_t labels = read_pod<uint32_t>(counts);
+            if (not counts or labels > size / 9)
+            {
+                counts.setstate(ios::failbit);
+                break;
+            }
+            i.resize(labels);
+            for (auto &&j : i)
+            {
+                if (read_pod<uint8_t>(counts) == 0)
+                    j.first = read_pod<double>(counts);
+                else
+                    j.first = read_string(counts);
+                j.second = read_pod<int32_t>(counts);
+            }
+        }
+        if (counts and multiplicities->size() == size_t(next->dataset->no_rows()))
+            next->multiplicities = multiplicities;
+        else
+            cerr << "Ignoring the unreadable label counts of " << filePath << ".\n";
+    }
+    int rows = next->dataset->no_rows();
+    vector<int> stored_at;
+    if (not next->multiplicities and _deduplicate)
+        next->multiplicities = deduplicate(*next->dataset, nullptr, stored_at);
+    next->ids = number_rows(rows, stored_at, next->dataset->no_rows());
+
+    if (_index)
+    {
+        auto index = _index->clone();
+        ifstream saved(filePath + ".index", ios::binary | ios::in);
+        if (saved.is_open() and index->load(saved, *next->dataset))
+            next->index = index;
+        else
+            next->index = build_index(*next->dataset);
+    }
+    next->prefilter = build_prefilter(*next->dataset);
+
+    _bounds.clear();
+    atomic_store(&_snapshot, next);
 }
 
 void KNN::train(const Dataset&)
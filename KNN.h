@@ -12,8 +12,19 @@
  */
 
 #include "classifire.h"
+#include "search_index.h"
+#include "knn_graph.h"
+#include "kd_tree.h"
+#include "prototype_selection.h"
+#include "class_prefilter.h"
 #include <iostream>
 #include <numeric>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <cstdint>
 
 using namespace std;
 
@@ -27,6 +38,87 @@ double euclidean_distance_mesure(Dataset *, const vector<Dataset::DataType> &, c
 class KNN : public Classifier
 {
 public:
+    /**
+     * @brief The labels of the identical training rows collapsed into one stored row, with their counts.
+     */
+    using LabelCounts = ::LabelCounts;
+
+    /**
+     * @brief A stable identifier of a training row, which survives compactions.
+     */
+    using RowId = int64_t;
+
+    /**
+     * @brief A block of rows inserted since the last compaction.
+     */
+    struct DeltaBlock
+    {
+        Dataset rows;      /**< The normalized rows. */
+        vector<RowId> ids; /**< The id of every row. */
+    };
+
+    /**
+     * @brief An immutable, published state of the model.
+     *
+     * A snapshot bundles the normalized training dataset together with its normalization parameters
+     * (kept in `Dataset::local_parms`). Once published it is never modified; a new model is built
+     * off to the side and swapped in as a whole, so a query always sees one consistent model.
+     *
+     * Incremental updates are layered on top of the compacted `dataset`, which is shared between
+     * snapshots: inserted rows live in `delta` and erased rows are marked in `tombstones`.
+     * Rows are numbered over the dataset first and then the delta blocks, in order; these positions change
+     * at every compaction, the ids in `ids` and in the blocks do not. The search index, if any, is built
+     * over the compacted dataset only; the delta is always scanned.
+     *
+     * Delta blocks are shared between snapshots too. An insert adds a block and merges it with the blocks
+     * before it that are not larger, like the digits of a binary counter, so a row is copied a logarithmic
+     * number of times until it is compacted.
+     */
+    struct Snapshot
+    {
+        shared_ptr<Dataset> dataset;              /**< The normalized, compacted training dataset. */
+        shared_ptr<const vector<RowId>> ids;      /**< The id of every row of `dataset`. */
+        vector<shared_ptr<DeltaBlock>> delta;     /**< The rows inserted since the last compaction, largest block first. */
+        unordered_set<int> tombstones;            /**< Rows erased since the last compaction. */
+        shared_ptr<SearchIndex> index; /**< The search index over `dataset`, null for a brute-force scan. */
+        shared_ptr<ClassPrefilter> prefilter; /**< The class-prototype filter over `dataset`, null to always search. */
+        shared_ptr<const vector<LabelCounts>> multiplicities; /**< The label counts of every row of `dataset`, null when rows are not deduplicated. */
+
+        /**
+         * @brief Retrieves a data point of the snapshot by value.
+         *
+         * @param at The row index, counted over the dataset and then the delta.
+         * @return A vector containing the values of the data point.
+         */
+        vector<Dataset::DataType> iterrow(int at) const;
+        /**
+         * @brief Find the dataset holding a row.
+         *
+         * @param at The row index, counted over the dataset and then the delta.
+         * @return The compacted dataset or the rows of a delta block, and the index of the row in it.
+         */
+        pair<Dataset *, int> locate(int at) const;
+        /**
+         * @brief Retrieves the stable id of a row.
+         *
+         * @param at The row index, counted over the dataset and then the delta.
+         * @return The id to pass to `erase`; with deduplication, the smallest id of the copies of the row.
+         */
+        RowId id(int at) const;
+        /**
+         * @brief Retrieves the number of rows, including the erased ones.
+         *
+         * @return The number of rows.
+         */
+        int no_rows() const;
+        /**
+         * @brief Retrieves the number of rows inserted since the last compaction, including the erased ones.
+         *
+         * @return The number of rows of the delta blocks.
+         */
+        int delta_rows() const;
+    };
+
     /**
      * @brief Predicts the class label for a given sample using KNN.
      *
@@ -34,10 +126,36 @@ public:
      * @return The predicted class label.
      */
     Dataset::DataType predict(const vector<Dataset::DataType> &sample) override;
+    /**
+     * @brief Predicts the class label for a given sample, with a per-query search effort.
+     *
+     * @param sample The input sample for which to predict the class label.
+     * @param nprobe The number of lists an inverted-file search index visits for this query, 0 for the index's
+     * setting; ignored by the other indexes and by a scan.
+     * @return The predicted class label.
+     */
+    Dataset::DataType predict(const vector<Dataset::DataType> &sample, unsigned int nprobe);
+    /**
+     * @brief Predicts the class label of a sample for several values of k from a single neighbor search.
+     *
+     * The neighbors are searched once, for the largest k; walking them nearest first, the exp(-d) weight of every
+     * label is accumulated and the leading label updated, and the leader is recorded whenever one of the requested
+     * values of k is reached. Each prediction is that of `predict` with the corresponding k, ties excepted.
+     *
+     * @param sample The input sample for which to predict the class labels.
+     * @param ks The numbers of nearest neighbors to consider, in any order.
+     * @param nprobe The number of lists an inverted-file search index visits, 0 for the index's setting (default is 0).
+     * @return The predicted class label for every value of `ks`, in the same order.
+     * @throw invalid_argument If one of `ks` is 0.
+     */
+    vector<Dataset::DataType> predict_multi_k(const vector<Dataset::DataType> &sample, const vector<unsigned int> &ks, unsigned int nprobe = 0);
     /**
      * @brief Evaluate the classifier's performance on a test dataset, return the confusion matrix,
      * and print a classification report including micro-accuracy, micro-recall, and micro-precision.
      *
+     * With the Euclidean measure over numeric attributes, the neighbors of all test rows are found together
+     * by a dual-tree search instead of one query per row.
+     *
      * @param testData The dataset used for evaluation.
      * @return A confusion matrix containing counts of actual and predicted labels for each class.
      */
@@ -50,10 +168,12 @@ public:
      * @param label The label for classification.
      * @param k The number of nearest neighbors to consider (default is 1).
      * @param proximity_measure The proximity measure function (default is Euclidean distance).
+     * @param deduplicate Whether to store identical rows once, with their label counts (default is false).
      */
     KNN(
         const string &path, const string &label, int k = 1,
-        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &) = euclidean_distance_mesure);
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &) = euclidean_distance_mesure,
+        bool deduplicate = false);
     /**
      * @brief Construct a KNN classifier using the specified training dataset and parameters.
      *
@@ -64,22 +184,57 @@ public:
      * @param k The number of nearest neighbors to consider (default is 1).
      * @param proximity_measure A pointer to the proximity measure function used to calculate distances between data points
      * (default is euclidean_distance_mesure).
+     * @param deduplicate Whether to store identical rows once, with their label counts (default is false).
      *
      * @note The proximity_measure function should take a Dataset pointer, two vectors of Dataset::DataType values representing
      * two data points, and return a distance measure.
+     *
+     * @note With deduplication, training rows whose attribute values other than the label are identical are stored as
+     * one row that remembers how many times each label occurred; a stored row then casts one vote per copy, up to
+     * k votes in total, so predictions match those of the full training set while searches scan fewer rows.
+     * Rows are deduplicated again at every compaction. Erasing a stored row erases all of its copies.
      */
-    KNN(const Dataset &train_dataset, int k = 1, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &) = euclidean_distance_mesure);
+    KNN(const Dataset &train_dataset, int k = 1, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &) = euclidean_distance_mesure,
+        bool deduplicate = false);
 
     /**
      * @brief Set the proximity measure function for the KNN classifier.
      *
      * This function sets the proximity measure function used by the KNN classifier to calculate distances between data points.
      * The proximity measure function should take a Dataset pointer and two vectors of Dataset::DataType values representing
-     * two data points, and it should return a distance measure.
+     * two data points, and it should return a distance measure. A search index in use is rebuilt for the new measure.
      *
      * @param proximity_measure A pointer to the proximity measure function.
      */
     void set_proximity_measure(double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &));
+    /**
+     * @brief Set the search backend used in place of the brute-force scan.
+     *
+     * The given index is used as a prototype: a copy is built over the training set of every published snapshot,
+     * starting with the current one. Pass a null pointer to go back to the brute-force scan. Parameters changed on
+     * the prototype afterwards only reach the next published snapshot; pass the number of lists an inverted-file index
+     * visits per query to `predict` or `first_knn` instead.
+     *
+     * @param index The unbuilt search index.
+     */
+    void set_index(shared_ptr<SearchIndex> index);
+    /**
+     * @brief Set a class-prototype filter run by `predict` before the neighbor search.
+     *
+     * The given filter is used as a prototype: a copy is built over the training set of every published snapshot,
+     * starting with the current one. Queries it decides skip the search while no rows were inserted since the last
+     * compaction, and search everything otherwise; the others search only the rows it keeps, and the inserted rows.
+     * Pass a null pointer to always search everything.
+     *
+     * @param prefilter The unbuilt filter.
+     */
+    void set_prefilter(shared_ptr<ClassPrefilter> prefilter);
+    /**
+     * @brief Get the search index of the current snapshot.
+     *
+     * @return The built index, or a null pointer for a brute-force scan.
+     */
+    shared_ptr<SearchIndex> get_index() const;
     /**
      * @brief Perform k-nearest neighbor search using the first k nearest neighbors.
      *
@@ -89,24 +244,173 @@ public:
      *
      * @param target The target data point for neighbor search.
      * @param comparison_fn A comparison function for sorting neighbors.
+     * @param nprobe The number of lists an inverted-file search index visits, 0 for the index's setting (default is 0).
      * @return Vector of pairs: proximity measure(distance or similarity) and data point index.
      */
     vector<pair<double, int>> first_knn(
         const vector<Dataset::DataType> &target, bool (*comparison_fn)(double, double) = [](double a, double b)
-                                                 { return a <= b; });
+                                                 { return a <= b; }, unsigned int nprobe = 0);
+    /**
+     * @brief Perform k-nearest neighbor search against a given snapshot with an explicit k.
+     *
+     * Use together with `snapshot()` when the returned indices have to be resolved against the same model.
+     *
+     * @param snapshot The snapshot to search.
+     * @param target The target data point for neighbor search.
+     * @param k The number of nearest neighbors to return.
+     * @param comparison_fn A comparison function for sorting neighbors.
+     * @param nprobe The number of lists an inverted-file search index visits, 0 for the index's setting (default is 0).
+     * @return Vector of pairs: proximity measure(distance or similarity) and data point index.
+     */
+    vector<pair<double, int>> first_knn(
+        Snapshot &snapshot, const vector<Dataset::DataType> &target, unsigned int k, bool (*comparison_fn)(double, double) = [](double a, double b)
+                                                                                    { return a <= b; }, unsigned int nprobe = 0);
+
+    /**
+     * @brief Build the approximate k-nearest neighbor graph of the whole training set with NN-Descent.
+     *
+     * Pending inserts and erasures are compacted first; the row indices of the graph refer to the dataset of the
+     * snapshot published by that compaction. The proximity measure must be a distance.
+     *
+     * @param k The number of neighbors of every row.
+     * @return The graph, every row's neighbors excluding itself.
+     */
+    KNNGraph knn_graph(unsigned int k);
+
+    /**
+     * @brief Shrink the training set to the prototypes kept by a selection pass and publish it.
+     *
+     * Pending inserts and erasures are compacted first. The number of rows before and after and the compression
+     * ratio are printed, and, given a validation set, the accuracy before and after.
+     *
+     * @param selection The prototype-selection pass (see prototype_selection.h).
+     * @param validation An (unnormalized) labelled dataset to measure the accuracy on, or a null pointer.
+     * @return The compression ratio: the number of rows before over the number kept.
+     */
+    double reduce(PrototypeSelection selection, Dataset *validation = nullptr);
+
+    /**
+     * @brief Weighted majority vote over a set of neighbors.
+     *
+     * Each neighbor votes for its label with weight exp(-d), normalized over all neighbors.
+     *
+     * @param neighbours Pairs of proximity measure and label of the nearest neighbors.
+     * @return The label with the largest total weight.
+     */
+    static Dataset::DataType vote(const vector<pair<double, Dataset::DataType>> &neighbours);
 
     /**
      * @brief Sets the dataset for the KNN classifier.
      *
+     * The new dataset is read and normalized off to the side and then published atomically (see `publish`),
+     * so queries running meanwhile keep using the previous model. The current label is carried over.
+     *
      * @param path The path to the dataset.
      */
     void set_dataset(const string &path);
+    /**
+     * @brief Build a new snapshot from the given dataset and publish it atomically.
+     *
+     * The dataset is copied and normalized without blocking readers, then swapped in with a single atomic store.
+     * Readers that grabbed the previous snapshot keep it alive until they release it; it is reclaimed when
+     * the last of them drains. Concurrent writers are serialized.
+     *
+     * @param dataset The (unnormalized) training dataset, with its label set.
+     */
+    void publish(const Dataset &dataset);
+    /**
+     * @brief Save the current model to a file.
+     *
+     * Pending inserts and erasures are compacted first. The normalized training set is written with
+     * `Dataset::save_binary`, and the search index, if it supports persistence, next to it in `filePath + ".index"`.
+     * The label counts of deduplicated rows are written to `filePath + ".counts"`.
+     *
+     * @param filePath The path to the file where the model will be saved.
+     */
+    void saveModel(const std::string &filePath) override;
+    /**
+     * @brief Load a model saved with `saveModel` and publish it.
+     *
+     * The search index set with `set_index` is restored from `filePath + ".index"` when it was saved with the
+     * same kind of index, and rebuilt otherwise.
+     *
+     * @param filePath The path to the file containing the saved model.
+     * @throw invalid_argument If the saved dataset is truncated or corrupt; the published model is left unchanged.
+     */
+    void loadModel(const std::string &filePath) override;
+    /**
+     * @brief Pair the nearest rows with their labels, expanding deduplicated rows into one vote per copy.
+     *
+     * @param snapshot The snapshot the rows belong to.
+     * @param neighbours Pairs of proximity measure and row index, nearest first.
+     * @param k The number of votes.
+     * @return Pairs of proximity measure and label, at most k of them.
+     */
+    static vector<pair<double, Dataset::DataType>> neighbour_labels(Snapshot &snapshot, const vector<pair<double, int>> &neighbours, unsigned int k);
+    /**
+     * @brief Grab the currently published snapshot.
+     *
+     * The returned pointer keeps the snapshot alive for as long as it is held, whatever is published meanwhile.
+     * Row indices returned by `first_knn` refer to the snapshot that was current during that call.
+     *
+     * @return A shared pointer to the current snapshot.
+     */
+    shared_ptr<Snapshot> snapshot() const;
+    /**
+     * @brief Add a labelled example to the training set without a rebuild.
+     *
+     * The row is normalized against the current bounds and published in a new snapshot. Bounds are widened,
+     * and the stored rows rescaled, at the next compaction.
+     *
+     * @param row A data point with a value for every attribute, the label included.
+     * @return The id of the row, to pass to `erase`.
+     */
+    RowId insert(const vector<Dataset::DataType> &row);
+    /**
+     * @brief Add a batch of labelled examples, publishing a single snapshot.
+     *
+     * @param rows The data points to add.
+     * @return The id of every row, in order.
+     */
+    vector<RowId> insert(const vector<vector<Dataset::DataType>> &rows);
+    /**
+     * @brief Retire a training example without a rebuild.
+     *
+     * The row is tombstoned and skipped by queries; it is physically dropped at the next compaction.
+     *
+     * @param id The id of the row, as returned by `insert` or `Snapshot::id`. The rows of a training set are
+     * numbered from 0 in their order when it is published or loaded, and the ids of inserted rows follow.
+     *
+     * @note Ids stay valid across compactions. Erasing a deduplicated row erases all of its copies. If no live
+     * row has this id, a range_error is thrown.
+     */
+    void erase(RowId id);
+    /**
+     * @brief Merge the pending inserts and erasures into a new compacted dataset and publish it.
+     *
+     * Runs synchronously; compaction is otherwise started in the background once the number of
+     * pending changes reaches the compaction threshold.
+     */
+    void compact();
+    /**
+     * @brief Set the number of pending inserts and erasures that triggers a background compaction.
+     *
+     * @param threshold The new threshold (default is 4096).
+     */
+    void set_compaction_threshold(unsigned int threshold);
+    /**
+     * @brief Waits for a running background compaction.
+     */
+    ~KNN();
     /**
      * @brief Get the Dataset object.
      *
-     * This function returns the Dataset object associated with the class instance.
+     * This function returns the Dataset object of the current snapshot.
      *
      * @return A reference to the Dataset object.
+     *
+     * @note The reference is only valid until the next `publish`/`set_dataset`; hold `snapshot()` instead when
+     * another thread may swap the model.
      */
     Dataset &get_dataset();
 
@@ -127,27 +431,107 @@ public:
     void set_k(unsigned int k);
 
 private:
-    unsigned int _k;                                                                                               /**< The number of nearest neighbors to consider. */
-    double (*_proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &); /**< The proximity measure function. */
-    Dataset dataset;                                                                                               /**< The dataset used for classification. */
+    atomic<unsigned int> _k;                                                                                               /**< The number of nearest neighbors to consider. */
+    atomic<double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)> _proximity_measure; /**< The proximity measure function. */
+    shared_ptr<Snapshot> _snapshot;                                                                                        /**< The published model, only accessed through atomic_load/atomic_store. */
+    mutex _writer;                                                                                                         /**< Serializes publishers. */
+    unsigned int _compaction_threshold = 4096;                                                                             /**< Pending changes that trigger a compaction. */
+    unordered_map<string, pair<double, double>> _bounds;                                                                   /**< Bounds widened by inserts, applied at compaction. */
+    atomic<bool> _compacting{false};                                                                                       /**< Whether a background compaction is running. */
+    thread _compactor;                                                                                                     /**< The background compaction thread. */
+    unordered_map<RowId, int> _positions;                                                                                  /**< The position of every live id in the latest snapshot. */
+    RowId _next_id = 0;                                                                                                    /**< The id of the next row published. */
+    shared_ptr<SearchIndex> _index;                                                                                        /**< The search index prototype, null for a brute-force scan. */
+    shared_ptr<ClassPrefilter> _prefilter;                                                                                 /**< The class-prototype filter prototype, null to always search. */
+    bool _deduplicate = false;                                                                                             /**< Whether identical training rows are stored once. */
     /**
-     * @brief Train the classifier using the provided training data.
+     * @brief Find the k nearest neighbors of every row of a dataset in one dual-tree traversal.
      *
-     * @param trainingData The dataset used for training.
+     * Applies only to the Euclidean measure when every attribute but the label is numeric, and only when the snapshot
+     * has no prefilter and no search index or an exact one, so that the neighbors are those `predict` would vote with.
+     *
+     * @param snapshot The snapshot to search.
+     * @param rows The (unnormalized) query rows, with the attributes of the training set.
+     * @param k The number of nearest neighbors.
+     * @param neighbours Filled with, for each row, pairs of distance and row index in the snapshot, nearest first.
+     * @return false if the search does not apply and the rows have to be queried one by one.
      */
-    void train(const Dataset &trainingData) override;
+    bool dual_tree_knn(Snapshot &snapshot, Dataset &rows, unsigned int k, vector<vector<pair<double, int>>> &neighbours);
     /**
-     * @brief Save the trained model to a file.
+     * @brief Perform k-nearest neighbor search over some rows of the dataset and all rows of the delta.
      *
-     * @param filePath The path to the file where the model will be saved.
+     * @param snapshot The snapshot to search.
+     * @param target The normalized target data point.
+     * @param candidates The rows of the dataset to search.
+     * @param k The number of nearest neighbors to return.
+     * @return Vector of pairs: proximity measure and data point index, nearest first.
      */
-    void saveModel(const std::string &filePath) override;
+    vector<pair<double, int>> candidate_knn(Snapshot &snapshot, const vector<Dataset::DataType> &target, const vector<int> &candidates, unsigned int k);
     /**
-     * @brief Load a previously trained model from a file.
+     * @brief Collapse the rows of a dataset whose attribute values other than the label are identical.
      *
-     * @param filePath The path to the file containing the saved model.
+     * @param dataset The dataset, deduplicated in place; the first of identical rows is kept.
+     * @param multiplicities The label counts of its rows, or a null pointer when every row is a single copy.
+     * @param stored_at Filled with the index, in the deduplicated dataset, of every row.
+     * @return The merged label counts of the kept rows.
      */
-    void loadModel(const std::string &filePath) override;
+    static shared_ptr<const vector<LabelCounts>> deduplicate(Dataset &dataset, const vector<LabelCounts> *multiplicities, vector<int> &stored_at);
+    /**
+     * @brief Follow the ids to the new positions of their rows. The caller must hold the writer lock.
+     *
+     * @param moved The new position of every row of the latest snapshot, -1 for the dropped ones.
+     * @param rows The number of rows at the new positions.
+     * @return The id of every row at the new positions.
+     */
+    shared_ptr<const vector<RowId>> move_rows(const vector<int> &moved, int rows);
+    /**
+     * @brief Number the rows of a newly published dataset. The caller must hold the writer lock.
+     *
+     * @param rows The number of rows before deduplication.
+     * @param stored_at The index of every row after deduplication, or empty when the rows were kept as they are.
+     * @param kept The number of rows after deduplication.
+     * @return The id of every kept row.
+     */
+    shared_ptr<const vector<RowId>> number_rows(int rows, const vector<int> &stored_at, int kept);
+    /**
+     * @brief Classify every row of a test dataset.
+     *
+     * @param testData The dataset to classify.
+     * @return A confusion matrix containing counts of actual and predicted labels for each class.
+     */
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> classify(Dataset &testData);
+    /**
+     * @brief Build a copy of the search index prototype over a dataset. The caller must hold the writer lock.
+     *
+     * @return The built index, or a null pointer if no index is set.
+     */
+    shared_ptr<SearchIndex> build_index(Dataset &dataset);
+    /**
+     * @brief Build a copy of the class-prototype filter over a dataset. The caller must hold the writer lock.
+     *
+     * @return The built filter, or a null pointer if no filter is set.
+     */
+    shared_ptr<ClassPrefilter> build_prefilter(Dataset &dataset);
+    /**
+     * @brief Publish the current snapshot with a freshly built index and filter. The caller must hold the writer lock.
+     */
+    void republish_index();
+    /**
+     * @brief Publish a snapshot that shares the current dataset with the given delta and tombstones.
+     *
+     * The caller must hold the writer lock.
+     */
+    void publish_changes(vector<shared_ptr<DeltaBlock>> delta, unordered_set<int> tombstones);
+    /**
+     * @brief Merge the current snapshot into a new compacted dataset. The caller must hold the writer lock.
+     */
+    void compact_locked();
+    /**
+     * @brief Train the classifier using the provided training data.
+     *
+     * @param trainingData The dataset used for training.
+     */
+    void train(const Dataset &trainingData) override;
 };
 
 #endif
@@ -1,8 +1,7 @@
 #include <bits/stdc++.h>
 #include "dataset.h"
 #include "KNN.h"
-
-#define all(a) a.begin(), a.end()
+#include "string_similarity.h"
 
 int main()
 {
@@ -10,21 +9,13 @@ int main()
     arabic_names.set_label("gender");
     arabic_names.split(train, test); 
 
-    // set Jaccard Similarity
+    // set Jaccard Similarity, over the characters (codepoints) of the names
     KNN knn(train, 5);
     vector<Dataset::DataType> x;
 
-    knn.set_proximity_measure([](Dataset *, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b)
-                              {
-                                multiset<char> _a (all(get<string>(a[0]))), _b (all(get<string>(b[0])));
-                                vector<char> r;
+    knn.set_proximity_measure(jaccard_distance_mesure);
+    knn.set_index(make_shared<SignatureIndex>(jaccard_distance));
 
-                                set_intersection(all(_a), all(_b), back_inserter(r));
-    
-                                return  1-(1.0 * r.size() / 
-                                       (_a.size() + _b.size() - r.size())); 
-                              });
-                              
     knn.evaluate(test);   
 
     string name;
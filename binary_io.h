@@ -0,0 +1,120 @@
+#ifndef H_BINARY_IO
+#define H_BINARY_IO
+/**
+ * @file binary_io.h
+ * @brief Helpers to read and write plain values and strings in binary files.
+ *
+ * Values are written in the native representation (little-endian on the supported platforms); strings are
+ * prefixed with their length as a uint32.
+ *
+ * The stream readers never trust a size read from the file: a truncated or corrupt stream leaves the failbit set
+ * and yields a zero value or an empty container, and memory is only allocated as the bytes actually arrive.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+template <typename T>
+inline void write_pod(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+inline T read_pod(std::istream &in)
+{
+    T value{};
+    if (not in.read(reinterpret_cast<char *>(&value), sizeof(T)))
+        value = T{};
+    return value;
+}
+
+/**
+ * @brief Read `count` plain values into a container, growing it one chunk at a time.
+ *
+ * A bogus count in a corrupt file then fails at the end of the stream instead of allocating it up front.
+ */
+template <typename Container>
+inline void read_chunked(std::istream &in, Container &values, uint64_t count)
+{
+    using T = typename Container::value_type;
+    const uint64_t chunk = (1 << 20) / sizeof(T) + 1;
+    values.clear();
+    if (not in or count > std::numeric_limits<size_t>::max() / sizeof(T))
+    {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+    for (uint64_t done = 0; done < count;)
+    {
+        uint64_t n = std::min(chunk, count - done);
+        values.resize(done + n);
+        if (not in.read(reinterpret_cast<char *>(&values[done]), n * sizeof(T)))
+        {
+            values.clear();
+            return;
+        }
+        done += n;
+    }
+}
+
+/**
+ * @brief Read a value from memory and advance the cursor past it.
+ */
+template <typename T>
+inline T read_pod(const char *&cursor)
+{
+    T value;
+    memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+inline void write_string(std::ostream &out, const std::string &str)
+{
+    write_pod<uint32_t>(out, str.size());
+    out.write(str.data(), str.size());
+}
+
+inline std::string read_string(std::istream &in)
+{
+    std::string str;
+    read_chunked(in, str, read_pod<uint32_t>(in));
+    return str;
+}
+
+/**
+ * @brief Read a string from memory and advance the cursor past it.
+ */
+inline std::string read_string(const char *&cursor)
+{
+    uint32_t size = read_pod<uint32_t>(cursor);
+    std::string str(cursor, size);
+    cursor += size;
+    return str;
+}
+
+/**
+ * @brief Write a vector of plain values, prefixed by its size.
+ */
+template <typename T>
+inline void write_vector(std::ostream &out, const std::vector<T> &values)
+{
+    write_pod<uint64_t>(out, values.size());
+    out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+inline std::vector<T> read_vector(std::istream &in)
+{
+    std::vector<T> values;
+    read_chunked(in, values, read_pod<uint64_t>(in));
+    return values;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "bk_tree_index.h"
+#include "string_similarity.h"
+#include <queue>
+
+BKTreeIndex::BKTreeIndex(bool transpositions) : _transpositions{transpositions}
+{
+}
+
+int BKTreeIndex::distance(const vector<u32string> &a, const vector<u32string> &b) const
+{
+    int sum = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        sum += _transpositions ? damerau_distance(a[i], b[i]) : levenshtein_distance(a[i], b[i]);
+    }
+    return sum;
+}
+
+void BKTreeIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    _nodes.clear();
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != dataset.get_label() and find(numerics.begin(), numerics.end(), keys[i]) == numerics.end())
+            _attributes.push_back(i);
+    }
+
+    _values.assign(dataset.no_rows(), {});
+    for (int i = 0; i < dataset.no_rows(); i++)
+    {
+        auto row = dataset.iterrow(i);
+        for (auto &&j : _attributes)
+        {
+            _values[i].push_back(decode_utf8(get<string>(row[j])));
+        }
+    }
+
+    for (int i = 0; i < dataset.no_rows(); i++)
+    {
+        _nodes.push_back({i, {}});
+        if (i == 0)
+            continue;
+
+        // walk down from the root along the edge of the same distance until a free slot.
+        int node = 0;
+        while (true)
+        {
+            int d = distance(_values[_nodes[node].row], _values[i]);
+            auto &children = _nodes[node].children;
+            auto child = find_if(children.begin(), children.end(), [&](const pair<int, int> &a)
+                                 { return a.first == d; });
+            if (child == children.end())
+            {
+                children.push_back(make_pair(d, i));
+                break;
+            }
+            node = child->second;
+        }
+    }
+}
+
+vector<pair<double, int>> BKTreeIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    vector<u32string> query;
+    for (auto &&i : _attributes)
+    {
+        query.push_back(decode_utf8(get<string>(target[column(dataset, target, i)])));
+    }
+
+    priority_queue<pair<int, int>> best;                                              // max-heap of (distance, row)
+    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pending; // min-heap of (lower bound, node)
+    if (not _nodes.empty() and k > 0)
+        pending.push(make_pair(0, 0));
+
+    while (not pending.empty())
+    {
+        auto [bound, node] = pending.top();
+        pending.pop();
+
+        int tau = best.size() < k ? INT32_MAX : best.top().first;
+        if (bound > tau)
+            break;
+
+        int d = distance(_values[_nodes[node].row], query);
+        if (best.size() < k)
+        {
+            best.push(make_pair(d, _nodes[node].row));
+        }
+        else if (d < best.top().first)
+        {
+            best.pop();
+            best.push(make_pair(d, _nodes[node].row));
+        }
+        tau = best.size() < k ? INT32_MAX : best.top().first;
+
+        // by the triangle inequality, a row under edge e is at least |e - d| away from the query.
+        for (auto &&child : _nodes[node].children)
+        {
+            if (abs(child.first - d) <= tau)
+                pending.push(make_pair(abs(child.first - d), child.second));
+        }
+    }
+
+    vector<pair<double, int>> res;
+    for (; not best.empty(); best.pop())
+    {
+        res.push_back(make_pair(best.top().first, best.top().second));
+    }
+    reverse(res.begin(), res.end());
+
+    return res;
+}
+
+shared_ptr<SearchIndex> BKTreeIndex::clone() const
+{
+    return make_shared<BKTreeIndex>(_transpositions);
+}
@@ -0,0 +1,63 @@
+#ifndef H_BK_TREE_INDEX
+#define H_BK_TREE_INDEX
+/**
+ * @file bk_tree_index.cpp
+ * @brief Implementation of a BK-tree search backend for edit distances over string attributes.
+ *
+ * This file contains the implementation of the `BKTreeIndex` class. A BK-tree arranges the training rows by their
+ * integer edit distance to each node; the triangle inequality then bounds which subtrees may hold a neighbor,
+ * so a query only visits a small part of the tree.
+ */
+
+#include "search_index.h"
+#include "edit_distance.h"
+
+/**
+ * @brief A BK-tree over the edit distance summed across the categorical attributes, the label excluded.
+ *
+ * Pair it with the matching proximity measure (`levenshtein_distance_mesure`, or `damerau_distance_mesure` when
+ * built with transpositions) so rows inserted since the last compaction are scored the same way.
+ *
+ * @note The optimal string alignment distance used for transpositions may break the triangle inequality, in which
+ * case a neighbor can occasionally be missed; the Levenshtein tree is exact.
+ */
+class BKTreeIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs a BK-tree index.
+     *
+     * @param transpositions Whether to use the Damerau (optimal string alignment) distance (default is false).
+     */
+    BKTreeIndex(bool transpositions = false);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+private:
+    /**
+     * @brief A node of the tree, holding one training row.
+     */
+    struct Node
+    {
+        int row;                           /**< The training row. */
+        vector<pair<int, int>> children;   /**< Pairs of edge distance and child node. */
+    };
+
+    bool _transpositions;                 /**< Whether transpositions count as a single edit. */
+    vector<int> _attributes;              /**< The positions of the indexed attributes. */
+    vector<vector<u32string>> _values;    /**< The decoded values, per row and then per attribute. */
+    vector<Node> _nodes;                  /**< The nodes, the root first. */
+
+    /**
+     * @brief Summed edit distance between a row and a query.
+     */
+    int distance(const vector<u32string> &a, const vector<u32string> &b) const;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "class_prefilter.h"
+#include <cmath>
+#include <limits>
+
+ClassPrefilter::ClassPrefilter(unsigned int prototypes, double margin) : _prototypes{max(prototypes, 1u)}, _margin{max(margin, 0.0)} {}
+
+void ClassPrefilter::build(Dataset &dataset)
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    _centroids.clear();
+    _labels.clear();
+    _members.clear();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != dataset.get_label() and find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            _attributes.push_back(i);
+    }
+    if (_attributes.empty() or dataset.no_rows() == 0)
+        return;
+
+    // the rows of every class, packed.
+    size_t dim = _attributes.size();
+    auto &labels = dataset[dataset.get_label()];
+    unordered_map<Dataset::DataType, vector<int>> classes;
+    for (int i = 0; i < dataset.no_rows(); i++)
+    {
+        classes[labels[i]].push_back(i);
+    }
+
+    for (auto &&i : classes)
+    {
+        auto &rows = i.second;
+        vector<float> data(rows.size() * dim);
+        for (size_t j = 0; j < dim; j++)
+        {
+            auto &values = dataset[keys[_attributes[j]]];
+            for (size_t r = 0; r < rows.size(); r++)
+            {
+                data[r * dim + j] = get<double>(values[rows[r]]);
+            }
+        }
+
+        KMeans prototypes(_prototypes);
+        prototypes.fit(data.data(), rows.size(), dim);
+        auto assignment = prototypes.assign(data.data(), rows.size());
+        size_t first = _labels.size();
+        _centroids.insert(_centroids.end(), prototypes.centroids().begin(), prototypes.centroids().end());
+        _labels.insert(_labels.end(), prototypes.size(), i.first);
+        _members.resize(_labels.size());
+        for (size_t r = 0; r < rows.size(); r++)
+        {
+            _members[first + assignment[r]].push_back(rows[r]);
+        }
+    }
+}
+
+ClassPrefilter::Result ClassPrefilter::filter(const Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k) const
+{
+    Result res;
+    if (_labels.empty())
+        return res;
+
+    // the target may lack the label value, which shifts the attributes after it.
+    auto keys = dataset.get_attributes();
+    int l = find(keys.begin(), keys.end(), dataset.get_label()) - keys.begin();
+    size_t dim = _attributes.size();
+    vector<float> query(dim);
+    for (size_t j = 0; j < dim; j++)
+    {
+        int at = target.size() == keys.size() or _attributes[j] < l ? _attributes[j] : _attributes[j] - 1;
+        query[j] = get<double>(target[at]);
+    }
+
+    vector<float> distances(_labels.size());
+    size_t nearest = 0;
+    for (size_t i = 0; i < _labels.size(); i++)
+    {
+        distances[i] = sqrt(squared_l2(query.data(), _centroids.data() + i * dim, dim));
+        if (distances[i] < distances[nearest])
+            nearest = i;
+    }
+    float runner_up = numeric_limits<float>::max();
+    for (size_t i = 0; i < _labels.size(); i++)
+    {
+        if (not(_labels[i] == _labels[nearest]))
+            runner_up = min(runner_up, distances[i]);
+    }
+
+    if (runner_up >= distances[nearest] * (1 + _margin))
+    {
+        res.decided = true;
+        res.label = _labels[nearest];
+        return res;
+    }
+
+    for (size_t i = 0; i < _labels.size(); i++)
+    {
+        if (distances[i] <= runner_up * (1 + _margin))
+            res.candidates.insert(res.candidates.end(), _members[i].begin(), _members[i].end());
+    }
+    res.restricted = res.candidates.size() >= k;
+    if (not res.restricted)
+        res.candidates.clear();
+    return res;
+}
+
+shared_ptr<ClassPrefilter> ClassPrefilter::clone() const
+{
+    return make_shared<ClassPrefilter>(_prototypes, _margin);
+}
@@ -0,0 +1,82 @@
+#ifndef H_CLASS_PREFILTER
+#define H_CLASS_PREFILTER
+/**
+ * @file class_prefilter.cpp
+ * @brief Implementation of a first-stage filter for KNN predictions based on class prototypes.
+ *
+ * This file contains the implementation of the `ClassPrefilter` class. Every class of the training set is summarized
+ * by its centroid, or by the centroids of a k-means clustering of its rows, over the normalized numeric features.
+ * A query first measures its distance to these prototypes: when the nearest one belongs to a class whose prototypes
+ * are nearer, by the margin, than those of every other class, that class is the prediction and the neighbor search
+ * is skipped; otherwise the search is restricted to the rows of the prototypes in contention.
+ */
+
+#include "kmeans.h"
+#include "dataset.h"
+#include <memory>
+
+/**
+ * @brief Per-class centroids or k-means prototypes, used to decide or narrow a KNN query before the full search.
+ *
+ * Distances to the prototypes are Euclidean over the normalized numeric features, whatever the proximity measure
+ * of the classifier; a dataset without numeric features is never filtered.
+ */
+class ClassPrefilter
+{
+public:
+    /**
+     * @brief The outcome of filtering a query.
+     */
+    struct Result
+    {
+        bool decided = false;       /**< Whether one class is unambiguously nearest. */
+        Dataset::DataType label;    /**< The class, when decided. */
+        bool restricted = false;    /**< Whether the search can be restricted to `candidates`. */
+        vector<int> candidates;     /**< The rows of the prototypes in contention, when restricted. */
+    };
+
+    /**
+     * @brief Constructs an unbuilt filter.
+     *
+     * @param prototypes The number of k-means prototypes per class, 1 for the class centroid (default is 1).
+     * @param margin The relative margin by which the nearest class must beat every other one (default is 0.5).
+     */
+    ClassPrefilter(unsigned int prototypes = 1, double margin = 0.5);
+
+    /**
+     * @brief Compute the prototypes of every class of a (normalized) training dataset.
+     *
+     * @param dataset The dataset, with its label set.
+     */
+    void build(Dataset &dataset);
+
+    /**
+     * @brief Decide a query from the prototypes, or narrow it down to the rows worth searching.
+     *
+     * The query is decided when the distance to the nearest prototype of every other class is at least (1 + margin)
+     * times the distance to the nearest prototype. Otherwise the candidates are the rows of every prototype within
+     * (1 + margin) times the distance to the nearest prototype of the runner-up class; the search is not restricted
+     * when they are fewer than k.
+     *
+     * @param dataset The dataset the filter was built over.
+     * @param target The normalized target data point, with or without the label value.
+     * @param k The number of nearest neighbors the search needs.
+     * @return The outcome.
+     */
+    Result filter(const Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k) const;
+
+    /**
+     * @brief Construct an unbuilt filter with the same parameters, to be built over another dataset.
+     */
+    shared_ptr<ClassPrefilter> clone() const;
+
+private:
+    unsigned int _prototypes;          /**< The number of prototypes per class. */
+    double _margin;                    /**< The relative decision margin. */
+    vector<int> _attributes;           /**< The positions of the numeric, non-label attributes. */
+    vector<float> _centroids;          /**< The prototypes, row-major. */
+    vector<Dataset::DataType> _labels; /**< The class of every prototype. */
+    vector<vector<int>> _members;      /**< The rows assigned to every prototype. */
+};
+
+#endif
@@ -12,6 +12,7 @@
  */
 
 #include "dataset.h"
+#include <cmath>
 
 /**
  * @brief Abstract base class for machine learning classifiers.
@@ -40,6 +41,44 @@ protected:
      */
     virtual void train(const Dataset &trainingData) = 0;
 
+    /**
+     * @brief Print a classification report including micro-accuracy, micro-recall, and micro-precision.
+     *
+     * @param confusion_matrix Counts of actual and predicted labels for each class.
+     */
+    static void report(const unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> &confusion_matrix)
+    {
+        unordered_map<string, vector<double>> confusion_matrix_elements;
+
+        double TN = 0.0;
+        for (auto &&i : confusion_matrix)
+        {
+            for (auto &&j : i.second)
+            {
+                if (i.first == j.first)
+                {
+                    confusion_matrix_elements["TP"].push_back(j.second);
+                    TN += j.second;
+                }
+                else
+                {
+                    confusion_matrix_elements["FN"].push_back(j.second);
+                    confusion_matrix_elements["FP"].push_back(j.second);
+                }
+                TN += j.second;
+            }
+        }
+
+        double TP = accumulate(confusion_matrix_elements["TP"].begin(), confusion_matrix_elements["TP"].end(), 0.0),
+               FN = accumulate(confusion_matrix_elements["FN"].begin(), confusion_matrix_elements["FN"].end(), 0.0),
+               FP = accumulate(confusion_matrix_elements["FP"].begin(), confusion_matrix_elements["FP"].end(), 0.0);
+
+        std::cout << "\nModel Micro-Precision : " << (int)round((TP / (TP + FP)) * 100) << "%"
+             << "\nModel Micro-Recall    : " << (int)round((TP / (TP + FN)) * 100) << "%"
+             << "\nModel Micro-Accuracy  : " << (int)round(((TP + TN) / (TP + TN + FP + FN)) * 100) << "%\n"
+             << endl;
+    }
+
 public:
     /**
      * @brief Predict the class label for a given sample.
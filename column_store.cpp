@@ -0,0 +1,315 @@
+#include "column_store.h"
+#include "KNN.h"
+#include <cstring>
+#include <limits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    template <typename T>
+    void append(vector<char> &codes, T value)
+    {
+        codes.resize(codes.size() + sizeof(T));
+        memcpy(codes.data() + codes.size() - sizeof(T), &value, sizeof(T));
+    }
+
+    /**
+     * @brief The narrowest integer type holding a span of codes.
+     */
+    StorageType integer_type(double span)
+    {
+        if (span <= numeric_limits<uint8_t>::max())
+            return StorageType::int8;
+        if (span <= numeric_limits<uint16_t>::max())
+            return StorageType::int16;
+        return StorageType::int32;
+    }
+
+    /**
+     * @brief The smallest code of an integer type; int32 codes start at 0 so they stay exact as floats.
+     */
+    double lowest_code(StorageType type)
+    {
+        if (type == StorageType::int8)
+            return numeric_limits<int8_t>::min();
+        if (type == StorageType::int16)
+            return numeric_limits<int16_t>::min();
+        return 0;
+    }
+
+    void store(vector<char> &codes, StorageType type, double value)
+    {
+        if (type == StorageType::int8)
+            append<int8_t>(codes, value);
+        else if (type == StorageType::int16)
+            append<int16_t>(codes, value);
+        else if (type == StorageType::int32)
+            append<int32_t>(codes, value);
+        else
+            append<float>(codes, value);
+    }
+
+    /**
+     * @brief acc[i] += w * (codes[i] - t)^2, widening the codes to float.
+     */
+    template <typename T>
+    void accumulate_scalar(const T *codes, size_t n, float t, float w, float *acc)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            float d = (float)codes[i] - t;
+            acc[i] += w * d * d;
+        }
+    }
+
+#if defined(__SSE2__)
+    inline void accumulate_4(__m128 values, __m128 t, __m128 w, float *acc)
+    {
+        __m128 d = _mm_sub_ps(values, t);
+        _mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(w, _mm_mul_ps(d, d))));
+    }
+
+    // sign-extend with unpack and arithmetic shifts, SSE2 has no widening moves.
+    inline void accumulate_8(__m128i words, __m128 t, __m128 w, float *acc)
+    {
+        accumulate_4(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16)), t, w, acc);
+        accumulate_4(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16)), t, w, acc + 4);
+    }
+#endif
+
+    void accumulate(const char *codes, StorageType type, size_t n, float t, float w, float *acc)
+    {
+        size_t i = 0;
+#if defined(__SSE2__)
+        __m128 vt = _mm_set1_ps(t), vw = _mm_set1_ps(w);
+        if (type == StorageType::int8)
+        {
+            for (; i + 16 <= n; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128((const __m128i *)(codes + i));
+                accumulate_8(_mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8), vt, vw, acc + i);
+                accumulate_8(_mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8), vt, vw, acc + i + 8);
+            }
+        }
+        else if (type == StorageType::int16)
+        {
+            for (; i + 8 <= n; i += 8)
+            {
+                accumulate_8(_mm_loadu_si128((const __m128i *)(codes + 2 * i)), vt, vw, acc + i);
+            }
+        }
+        else if (type == StorageType::int32)
+        {
+            for (; i + 4 <= n; i += 4)
+            {
+                accumulate_4(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(codes + 4 * i))), vt, vw, acc + i);
+            }
+        }
+        else
+        {
+            for (; i + 4 <= n; i += 4)
+            {
+                accumulate_4(_mm_loadu_ps((const float *)(codes + 4 * i)), vt, vw, acc + i);
+            }
+        }
+#endif
+        if (type == StorageType::int8)
+            accumulate_scalar((const int8_t *)codes + i, n - i, t, w, acc + i);
+        else if (type == StorageType::int16)
+            accumulate_scalar((const int16_t *)codes + i, n - i, t, w, acc + i);
+        else if (type == StorageType::int32)
+            accumulate_scalar((const int32_t *)codes + i, n - i, t, w, acc + i);
+        else
+            accumulate_scalar((const float *)codes + i, n - i, t, w, acc + i);
+    }
+
+    /**
+     * @brief acc[i] += (codes[i] == code), the categorical term of the Euclidean measure.
+     */
+    template <typename T>
+    void accumulate_matches(const T *codes, size_t n, T code, float *acc)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            acc[i] += codes[i] == code;
+        }
+    }
+
+    size_t width(StorageType type)
+    {
+        return type == StorageType::int8 ? 1 : type == StorageType::int16 ? 2
+                                                                            : 4;
+    }
+}
+
+ColumnStore::ColumnStore(unsigned int block_rows) : _block_rows(max(block_rows, 16u)) {}
+
+void ColumnStore::build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    _exact = proximity_measure == euclidean_distance_mesure;
+    _rows = dataset.no_rows();
+    _numeric.clear();
+    _categorical.clear();
+    _positions.clear();
+
+    auto keys = dataset.get_attributes();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == dataset.get_label() or _rows == 0)
+            continue;
+        auto &values = dataset[keys[i]];
+
+        if (holds_alternative<string>(values.front()))
+        {
+            CategoricalColumn column;
+            column.attribute = i;
+            for (auto &&j : values)
+            {
+                column.values.insert(make_pair(get<string>(j), (int32_t)column.values.size()));
+            }
+            column.type = integer_type(column.values.size() - 1);
+            for (auto &&j : values)
+            {
+                store(column.codes, column.type, column.values.at(get<string>(j)) + lowest_code(column.type));
+            }
+            _categorical.push_back(move(column));
+            continue;
+        }
+
+        // normalized values are mapped back to the raw ones, which are often integers.
+        NumericColumn column;
+        column.attribute = i;
+        double min = 0, max = 1;
+        auto low = dataset.local_parms.find(keys[i] + " nmin"), high = dataset.local_parms.find(keys[i] + " nmax");
+        if (low != dataset.local_parms.end() and high != dataset.local_parms.end())
+        {
+            min = get<double>(low->second);
+            max = get<double>(high->second);
+        }
+
+        bool integral = max > min;
+        double raw_low = numeric_limits<double>::max(), raw_high = numeric_limits<double>::lowest();
+        for (auto &&j : values)
+        {
+            double raw = get<double>(j) * (max - min) + min;
+            integral = integral and abs(raw - round(raw)) <= 1e-9 * std::max(1.0, abs(raw));
+            raw_low = std::min(raw_low, round(raw));
+            raw_high = std::max(raw_high, round(raw));
+        }
+        // codes are offsets from the smallest value, float holds them exactly up to 2^24.
+        integral = integral and raw_high - raw_low <= (1 << 24);
+
+        column.type = integral ? integer_type(raw_high - raw_low) : StorageType::float32;
+        double base = integral ? raw_low - lowest_code(column.type) : 0;
+        if (integral)
+        {
+            column.scale = 1 / (max - min);
+            column.offset = (base - min) / (max - min);
+        }
+        for (auto &&j : values)
+        {
+            store(column.codes, column.type, integral ? round(get<double>(j) * (max - min) + min) - base : get<double>(j));
+        }
+        _positions[keys[i]] = _numeric.size();
+        _numeric.push_back(move(column));
+    }
+}
+
+vector<pair<double, int>> ColumnStore::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    vector<int> candidates;
+    if (k == 0)
+        return {};
+    if (not _exact or proximity_measure != euclidean_distance_mesure or k >= (unsigned int)_rows)
+    {
+        candidates.resize(_rows);
+        iota(candidates.begin(), candidates.end(), 0);
+        return rerank(dataset, target, candidates, k, proximity_measure);
+    }
+
+    // the target in code space: (code - t)^2 * w is the squared difference of the normalized values.
+    vector<float> t, w;
+    for (auto &&i : _numeric)
+    {
+        double value = get<double>(target[column(dataset, target, i.attribute)]);
+        t.push_back((value - i.offset) / i.scale);
+        w.push_back(i.scale * i.scale);
+    }
+    const int32_t absent = numeric_limits<int32_t>::min(); // a value missing from the dictionary never matches.
+    vector<int32_t> codes;
+    for (auto &&i : _categorical)
+    {
+        auto code = i.values.find(get<string>(target[column(dataset, target, i.attribute)]));
+        codes.push_back(code == i.values.end() ? absent : code->second + (int32_t)lowest_code(i.type));
+    }
+
+    vector<float> distances(_rows, 0);
+    for (int begin = 0; begin < _rows; begin += _block_rows)
+    {
+        size_t n = std::min<size_t>(_block_rows, _rows - begin);
+        float *acc = distances.data() + begin;
+        for (size_t i = 0; i < _numeric.size(); i++)
+        {
+            accumulate(_numeric[i].codes.data() + begin * width(_numeric[i].type), _numeric[i].type, n, t[i], w[i], acc);
+        }
+        for (size_t i = 0; i < _categorical.size(); i++)
+        {
+            auto &column = _categorical[i];
+            if (codes[i] == absent)
+                continue;
+            if (column.type == StorageType::int8)
+                accumulate_matches((const int8_t *)column.codes.data() + begin, n, (int8_t)codes[i], acc);
+            else if (column.type == StorageType::int16)
+                accumulate_matches((const int16_t *)column.codes.data() + begin, n, (int16_t)codes[i], acc);
+            else
+                accumulate_matches((const int32_t *)column.codes.data() + begin, n, codes[i], acc);
+        }
+    }
+
+    // every row within float rounding of the k-th best may be a true neighbor, they are reranked exactly.
+    vector<float> sorted = distances;
+    nth_element(sorted.begin(), sorted.begin() + k - 1, sorted.end());
+    float threshold = sorted[k - 1] * (1 + 1e-4f) + 1e-5f * (_numeric.size() + 1);
+    for (int i = 0; i < _rows; i++)
+    {
+        if (distances[i] <= threshold)
+            candidates.push_back(i);
+    }
+    return rerank(dataset, target, candidates, k, proximity_measure);
+}
+
+shared_ptr<SearchIndex> ColumnStore::clone() const
+{
+    return make_shared<ColumnStore>(_block_rows);
+}
+
+bool ColumnStore::exact() const
+{
+    return true;
+}
+
+size_t ColumnStore::memory_usage() const
+{
+    size_t bytes = 0;
+    for (auto &&i : _numeric)
+    {
+        bytes += i.codes.size();
+    }
+    for (auto &&i : _categorical)
+    {
+        bytes += i.codes.size();
+    }
+    return bytes;
+}
+
+StorageType ColumnStore::get_storage_type(const string &attribute) const
+{
+    auto position = _positions.find(attribute);
+    if (position == _positions.end())
+        throw invalid_argument(attribute + " : not a stored numeric attribute.\n");
+    return _numeric[position->second].type;
+}
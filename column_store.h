@@ -0,0 +1,101 @@
+#ifndef H_COLUMN_STORE
+#define H_COLUMN_STORE
+/**
+ * @file column_store.cpp
+ * @brief Implementation of a typed, column-oriented copy of a dataset for fast Euclidean scans.
+ *
+ * This file contains the implementation of the `ColumnStore` class. Every attribute except the label is stored in
+ * the narrowest type holding its observed values: numeric attributes with integer raw values as int8, int16 or
+ * int32 codes with an affine map back to the normalized value, other numeric attributes as float32, and
+ * categorical attributes as dictionary codes. A query scans the columns block by block, widening the codes to
+ * float on the fly with SIMD, and the rows within rounding of the k-th best are reranked exactly.
+ */
+
+#include "search_index.h"
+#include <cstdint>
+
+/**
+ * @brief The element types of a typed column.
+ */
+enum class StorageType : uint8_t
+{
+    int8,
+    int16,
+    int32,
+    float32
+};
+
+/**
+ * @brief A typed, column-oriented copy of a dataset's attributes, searched with the Euclidean measure.
+ *
+ * Paired with `euclidean_distance_mesure` the store is exact: it returns the same neighbors as a scan. With any
+ * other measure it only holds the rows, and every row is reranked with that measure.
+ */
+class ColumnStore : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs a column store.
+     *
+     * @param block_rows The number of rows scanned across all columns at a time (default is 1024).
+     */
+    ColumnStore(unsigned int block_rows = 1024);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+    bool exact() const override;
+
+    /**
+     * @brief Retrieves the number of bytes used by the typed columns.
+     *
+     * @return The size of the column data.
+     */
+    size_t memory_usage() const;
+
+    /**
+     * @brief Retrieves the storage type chosen for an attribute.
+     *
+     * @param attribute The name of a numeric attribute that is not the label.
+     * @return The element type of its column.
+     */
+    StorageType get_storage_type(const string &attribute) const;
+
+private:
+    /**
+     * @brief A numeric attribute: normalized value = code * scale + offset.
+     */
+    struct NumericColumn
+    {
+        int attribute;      /**< The position of the attribute. */
+        StorageType type;   /**< The element type of the codes. */
+        vector<char> codes; /**< The codes, packed. */
+        double scale = 1;   /**< The step between consecutive codes. */
+        double offset = 0;  /**< The value of code 0. */
+    };
+
+    /**
+     * @brief A categorical attribute, as codes into its dictionary.
+     */
+    struct CategoricalColumn
+    {
+        int attribute;                          /**< The position of the attribute. */
+        StorageType type;                       /**< The element type of the codes (int8, int16 or int32). */
+        vector<char> codes;                     /**< The codes, packed. */
+        unordered_map<string, int32_t> values;  /**< The code of every distinct value. */
+    };
+
+    unsigned int _block_rows;                 /**< The number of rows per scan block. */
+    bool _exact = false;                      /**< Whether the store was built for the Euclidean measure. */
+    int _rows = 0;                            /**< The number of stored rows. */
+    vector<NumericColumn> _numeric;           /**< The numeric columns. */
+    vector<CategoricalColumn> _categorical;   /**< The categorical columns. */
+    unordered_map<string, size_t> _positions; /**< The numeric column of every numeric attribute. */
+};
+
+#endif
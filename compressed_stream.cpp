@@ -0,0 +1,170 @@
+#include "compressed_stream.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+
+namespace io = boost::iostreams;
+
+namespace
+{
+    bool ends_with(const string &path, const string &suffix)
+    {
+        return path.size() >= suffix.size() and path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /**
+     * @brief An output stream that owns its file sink, so the compressor is flushed before the file closes.
+     */
+    class CompressedOutput : public io::filtering_ostream
+    {
+    public:
+        ~CompressedOutput()
+        {
+            reset();
+        }
+    };
+}
+
+Compression compression_of(const string &path)
+{
+    if (ends_with(path, ".gz"))
+        return Compression::gzip;
+    if (ends_with(path, ".bz2"))
+        return Compression::bzip2;
+    if (ends_with(path, ".zst"))
+        return Compression::zstd;
+    return Compression::none;
+}
+
+PipelinedInput::PipelinedInput(const string &path, Compression codec, size_t chunk_size, size_t depth)
+    : istream(nullptr), _file(path, ios::in | ios::binary), _buffer(*this), _chunk_size(max<size_t>(chunk_size, 1)), _depth(max<size_t>(depth, 1))
+{
+    rdbuf(&_buffer);
+    if (not _file.is_open())
+    {
+        setstate(ios::failbit);
+        return;
+    }
+    _producer = thread(&PipelinedInput::produce, this, codec);
+}
+
+PipelinedInput::~PipelinedInput()
+{
+    {
+        lock_guard<mutex> guard(_lock);
+        _stop = true;
+    }
+    _changed.notify_all();
+    if (_producer.joinable())
+        _producer.join();
+}
+
+bool PipelinedInput::is_open() const
+{
+    return _file.is_open();
+}
+
+void PipelinedInput::produce(Compression codec)
+{
+    io::filtering_istreambuf source;
+    if (codec == Compression::gzip)
+        source.push(io::gzip_decompressor());
+    else if (codec == Compression::bzip2)
+        source.push(io::bzip2_decompressor());
+    else if (codec == Compression::zstd)
+        source.push(io::zstd_decompressor());
+    source.push(_file);
+
+    exception_ptr error;
+    while (not error)
+    {
+        vector<char> chunk(_chunk_size);
+        streamsize got = 0, n;
+        try
+        {
+            // small reads, so an error loses at most one slice of what was inflated.
+            while (got < (streamsize)chunk.size() and (n = source.sgetn(chunk.data() + got, min<streamsize>(chunk.size() - got, 1 << 14))) > 0)
+            {
+                got += n;
+            }
+        }
+        catch (...)
+        {
+            error = current_exception(); // hand over what was inflated before the error first.
+        }
+        chunk.resize(got);
+
+        unique_lock<mutex> guard(_lock);
+        _changed.wait(guard, [&]
+                      { return _stop or _queue.size() < _depth; });
+        if (_stop or (chunk.empty() and not error))
+            break;
+        if (not chunk.empty())
+            _queue.push_back(std::move(chunk));
+        _changed.notify_all();
+    }
+
+    lock_guard<mutex> guard(_lock);
+    _error = error;
+    _done = true;
+    _changed.notify_all();
+}
+
+PipelinedInput::Buffer::Buffer(PipelinedInput &owner) : _owner(owner) {}
+
+PipelinedInput::Buffer::int_type PipelinedInput::Buffer::underflow()
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    unique_lock<mutex> guard(_owner._lock);
+    _owner._changed.wait(guard, [&]
+                         { return _owner._done or not _owner._queue.empty(); });
+    if (_owner._queue.empty())
+    {
+        if (_owner._error)
+            rethrow_exception(_owner._error); // the istream turns this into the bad bit.
+        return traits_type::eof();
+    }
+
+    _current = std::move(_owner._queue.front());
+    _owner._queue.pop_front();
+    _owner._changed.notify_all();
+
+    setg(_current.data(), _current.data(), _current.data() + _current.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+unique_ptr<PipelinedInput> open_input(const string &path)
+{
+    return make_unique<PipelinedInput>(path, compression_of(path));
+}
+
+unique_ptr<ostream> open_output(const string &path)
+{
+    Compression codec = compression_of(path);
+    if (codec == Compression::none)
+    {
+        auto output = make_unique<ofstream>(path, ios::out);
+        if (not output->is_open())
+            return nullptr;
+        return output;
+    }
+
+    io::file_sink file(path, ios::out | ios::binary);
+    if (not file.is_open())
+        return nullptr;
+
+    auto output = make_unique<CompressedOutput>();
+    if (codec == Compression::gzip)
+        output->push(io::gzip_compressor());
+    else if (codec == Compression::bzip2)
+        output->push(io::bzip2_compressor());
+    else
+        output->push(io::zstd_compressor());
+    output->push(file);
+    return output;
+}
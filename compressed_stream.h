@@ -0,0 +1,117 @@
+#ifndef H_COMPRESSED_STREAM
+#define H_COMPRESSED_STREAM
+/**
+ * @file compressed_stream.cpp
+ * @brief Implementation of transparently compressed file streams for CSV and snapshot I/O.
+ *
+ * This file contains helpers that open a file for reading or writing through Boost.Iostreams filtering
+ * streambufs, picking gzip, bzip2 or zstd from the file extension. Input is decompressed on a background
+ * thread into a small ring of buffers, so inflating the next chunk overlaps with tokenizing the current one.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+using namespace std;
+
+/**
+ * @brief The compression codecs understood by `open_input` and `open_output`.
+ */
+enum class Compression
+{
+    none,
+    gzip,
+    bzip2,
+    zstd
+};
+
+/**
+ * @brief Picks the codec from the file extension: `.gz`, `.bz2` or `.zst`; anything else is uncompressed.
+ *
+ * @param path The path to the file.
+ * @return The codec matching the extension.
+ */
+Compression compression_of(const string &path);
+
+/**
+ * @brief An input stream that decompresses a file on a background thread.
+ *
+ * The decompressing thread fills fixed-size chunks and hands them over through a bounded queue; the stream
+ * reads straight out of the current chunk. Decompression errors end the stream with the bad bit set.
+ */
+class PipelinedInput : public istream
+{
+public:
+    /**
+     * @brief Opens a file for pipelined reading.
+     *
+     * @param path The path to the file.
+     * @param codec The codec of the file contents.
+     * @param chunk_size The size, in bytes, of each decompressed chunk.
+     * @param depth The number of decompressed chunks that may be waiting ahead of the reader.
+     */
+    PipelinedInput(const string &path, Compression codec, size_t chunk_size = 1 << 20, size_t depth = 4);
+
+    /**
+     * @brief Stops the decompressing thread and closes the file.
+     */
+    ~PipelinedInput();
+
+    /**
+     * @brief Checks whether the underlying file was opened.
+     */
+    bool is_open() const;
+
+private:
+    class Buffer : public streambuf
+    {
+    public:
+        Buffer(PipelinedInput &owner);
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        PipelinedInput &_owner;
+        vector<char> _current;
+    };
+
+    void produce(Compression codec);
+
+    ifstream _file;
+    Buffer _buffer;
+    size_t _chunk_size, _depth;
+
+    mutex _lock;
+    condition_variable _changed;
+    deque<vector<char>> _queue; /**< Decompressed chunks, oldest first. */
+    bool _done = false, _stop = false;
+    exception_ptr _error;
+    thread _producer;
+};
+
+/**
+ * @brief Opens a file for reading, decompressing it on a background thread when its extension names a codec.
+ *
+ * @param path The path to the file.
+ * @return The opened stream; check `is_open` before use.
+ */
+unique_ptr<PipelinedInput> open_input(const string &path);
+
+/**
+ * @brief Opens a file for writing, compressing it when its extension names a codec.
+ *
+ * @param path The path to the file.
+ * @return The opened stream, or nullptr if the file could not be created.
+ */
+unique_ptr<ostream> open_output(const string &path);
+
+#endif
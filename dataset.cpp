@@ -1,4 +1,33 @@
 #include "dataset.h"
+#include "binary_io.h"
+#include "compressed_stream.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    const char binary_magic[8] = {'K', 'N', 'N', 'C', 'O', 'L', 0, 0};
+    const uint32_t binary_version = 2; // version 1 stored a categorical flag instead of the column type.
+    const size_t binary_alignment = 64;
+
+    void write_value(ostream &out, const Dataset::DataType &value)
+    {
+        write_pod<uint8_t>(out, holds_alternative<string>(value));
+        if (holds_alternative<double>(value))
+            write_pod<double>(out, get<double>(value));
+        else
+            write_string(out, get<string>(value));
+    }
+
+    void align(ostream &out)
+    {
+        static const char zeros[binary_alignment] = {};
+        size_t position = out.tellp();
+        out.write(zeros, (binary_alignment - position % binary_alignment) % binary_alignment);
+    }
+}
 
 Dataset::Dataset(
     void (*normalizarion_function)(Dataset *),
@@ -11,100 +40,244 @@ Dataset::Dataset(const string &path)
     *this = read_csv(path);
 }
 
-Dataset Dataset::read_csv(const string &path)
+Dataset Dataset::read_csv(const string &path, const LoadOptions &options)
 {
-    Dataset dataset;
-    ifstream data(path, std::ios::in);
-    if (not data.is_open())
+    auto data = open_input(path);
+    if (not data->is_open())
     {
         cerr << path << " : No such file or the path is incorrect";
-        return dataset;
+        return Dataset();
     }
 
+    Dataset dataset = read_csv(*data, options);
+    if (data->bad())
+        cerr << path << " : the file is truncated or corrupt, read " << dataset.no_rows() << " rows.\n";
+    return dataset;
+}
+
+Dataset Dataset::read_csv(istream &data, const LoadOptions &options)
+{
+    Dataset dataset;
     string line;
 
-    getline(data, line);
-    if (line.back() == '\r')
+    if (not getline(data, line))
+        return dataset;
+    if (not line.empty() and line.back() == '\r')
         line.pop_back(); // remove the \r char.
 
-    int i = 0, j = 0;
-
-    while (true)
+    vector<string> header;
+    for (size_t i = 0, j = 0; j != string::npos; i = j + 1)
     {
         j = line.find(',', i);
-        int len = (j == string::npos) ? string::npos : j - i;
-        dataset.keys.push_back(line.substr(i, len));
-        dataset.m.insert(make_pair(dataset.keys.back(), vector<DataType>()));
-        if (j == string::npos)
+        header.push_back(line.substr(i, j == string::npos ? string::npos : j - i));
+    }
+
+    // slot[field] is the output column of a field, or -1 when the field is not kept.
+    vector<int> slot(header.size(), -1);
+    vector<bool (*)(const string &)> predicate(header.size(), nullptr);
+    const vector<string> &columns = options.columns.empty() ? header : options.columns;
+    for (auto &&name : columns)
+    {
+        auto field = find(header.begin(), header.end(), name);
+        if (field == header.end() or slot[field - header.begin()] != -1)
         {
-            break;
+            cerr << name << " : no such attribute or it is projected twice, it is skipped.\n";
+            continue;
         }
-        i = j + 1;
+        slot[field - header.begin()] = dataset.keys.size();
+        dataset.keys.push_back(name);
+        dataset.m.insert(make_pair(name, vector<DataType>()));
     }
-
-    getline(data, line);
-    if (line.back() == '\r')
-        line.pop_back();
-    int _ = 0;
-    i = j = 0;
-    while (true)
+    for (auto &&i : options.predicates)
     {
-        j = line.find(',', i);
-        int len = (j == string::npos) ? string::npos : j - i;
-        string entry = line.substr(i, len);
-        if (is_numeric(entry))
+        auto field = find(header.begin(), header.end(), i.first);
+        if (field == header.end())
         {
-            dataset._is_numeric.push_back(true);
-            dataset.m[dataset.keys[_]].push_back(atof(entry.c_str()));
+            cerr << i.first << " : no such attribute, its predicate is ignored.\n";
+            continue;
         }
-        else
+        predicate[field - header.begin()] = i.second;
+    }
+
+    vector<vector<DataType> *> output;
+    for (auto &&i : dataset.keys)
+    {
+        output.push_back(&dataset.m[i]);
+    }
+
+    vector<ColumnType> &types = dataset._types;
+    for (auto &&i : dataset.keys)
+    {
+        auto type = options.schema.find(i);
+        types.push_back(type == options.schema.end() ? ColumnType::categorical : type->second);
+    }
+
+    // the first rows are held back as text until the types of the attributes without a schema are inferred.
+    bool inferred = all_of(dataset.keys.begin(), dataset.keys.end(), [&](const string &key)
+                           { return options.schema.count(key); });
+    vector<pair<size_t, vector<string>>> pending; // with their line numbers.
+
+    vector<DataType> row(dataset.keys.size());
+    size_t line_number = 1;
+    auto store = [&](const vector<string> &entries, size_t at)
+    {
+        for (size_t i = 0; i < entries.size(); i++)
         {
-            dataset._is_numeric.push_back(false);
-            dataset.m[dataset.keys[_]].push_back(entry);
+            double value;
+            int digits;
+            bool fits = types[i] == ColumnType::categorical;
+            if (fits)
+                row[i] = entries[i];
+            else if (scan_number(entries[i].data(), entries[i].data() + entries[i].size(), value, &digits))
+            {
+                bool integral = value == trunc(value);
+                if (types[i] == ColumnType::uint8)
+                    fits = integral and value >= 0 and value <= 255;
+                else if (types[i] == ColumnType::int32)
+                    fits = integral and value >= numeric_limits<int32_t>::min() and value <= numeric_limits<int32_t>::max();
+                else
+                    fits = types[i] == ColumnType::float64 or (digits <= 7 and abs(value) <= numeric_limits<float>::max());
+
+                // an inferred type only saw a sample, so it widens instead of rejecting the value.
+                if (not fits and not options.schema.count(dataset.keys[i]))
+                {
+                    bool int32 = integral and value >= numeric_limits<int32_t>::min() and value <= numeric_limits<int32_t>::max();
+                    types[i] = int32 and types[i] == ColumnType::uint8 ? ColumnType::int32 : ColumnType::float64;
+                    fits = true;
+                }
+                row[i] = value;
+            }
+            if (not fits)
+            {
+                cerr << "line " << at << ", " << dataset.keys[i] << " : \"" << entries[i] << "\" does not fit the attribute type, the row is skipped.\n";
+                return;
+            }
         }
-        if (j == string::npos)
+        for (size_t i = 0; i < row.size(); i++)
         {
-            break;
+            output[i]->push_back(std::move(row[i]));
         }
-        ++_;
-        i = j + 1;
-    }
+        ++dataset._size;
+    };
 
-    while (getline(data, line))
+    auto infer = [&]()
     {
-        if (line.back() == '\r')
-            line.pop_back();
-        _ = i = j = 0;
-        while (true)
+        for (size_t i = 0; i < dataset.keys.size(); i++)
         {
-            j = line.find(',', i);
-            int len = (j == string::npos) ? string::npos : j - i;
-            string entry = line.substr(i, len);
+            if (options.schema.count(dataset.keys[i]))
+                continue;
 
-            if (dataset._is_numeric[_])
+            bool numeric = not pending.empty(), integral = true, narrow = true;
+            double low = 0, high = 0, value;
+            int digits;
+            for (auto &&row : pending)
             {
-                dataset.m[dataset.keys[_]].push_back(atof(entry.c_str()));
+                const string &text = row.second[i];
+                if (not scan_number(text.data(), text.data() + text.size(), value, &digits))
+                {
+                    numeric = false;
+                    break;
+                }
+                integral = integral and value == trunc(value);
+                narrow = narrow and digits <= 7 and abs(value) <= numeric_limits<float>::max();
+                low = min(low, value);
+                high = max(high, value);
             }
+
+            if (not numeric)
+                types[i] = ColumnType::categorical;
+            else if (integral and low >= 0 and high <= 255)
+                types[i] = ColumnType::uint8;
+            else if (integral and low >= numeric_limits<int32_t>::min() and high <= numeric_limits<int32_t>::max())
+                types[i] = ColumnType::int32;
+            else if (narrow)
+                types[i] = ColumnType::float32;
             else
+                types[i] = ColumnType::float64;
+        }
+        inferred = true;
+        for (auto &&i : pending)
+        {
+            store(i.second, i.first);
+        }
+        pending.clear();
+    };
+
+    mt19937 generator(options.seed);
+    bernoulli_distribution sampled(min(max(options.sample, 0.0), 1.0));
+    vector<size_t> begin(header.size()), end(header.size());
+    vector<string> entries(dataset.keys.size());
+    string entry;
+
+    while ((options.limit == 0 or (size_t)dataset._size + pending.size() < options.limit) and getline(data, line))
+    {
+        ++line_number;
+        if (options.sample < 1 and not sampled(generator))
+            continue;
+        if (not line.empty() and line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+
+        // find the field boundaries and evaluate the predicates before any value is materialized.
+        size_t fields = 0;
+        bool keep = true;
+        for (size_t i = 0, j = 0; j != string::npos and fields < header.size() and keep; i = j + 1, ++fields)
+        {
+            j = line.find(',', i);
+            begin[fields] = i;
+            end[fields] = j == string::npos ? line.size() : j;
+            if (predicate[fields])
             {
-                dataset.m[dataset.keys[_]].push_back(entry);
-            }
-            if (j == string::npos)
-            {
-                break;
+                entry.assign(line, begin[fields], end[fields] - begin[fields]);
+                keep = predicate[fields](entry);
             }
-            ++_;
-            i = j + 1;
         }
+        if (not keep)
+            continue;
+        if (fields < header.size())
+        {
+            cerr << "line " << line_number << " : has " << fields << " fields instead of " << header.size() << ", it is skipped.\n";
+            continue;
+        }
+
+        for (size_t i = 0; i < header.size(); i++)
+        {
+            if (slot[i] != -1)
+                entries[slot[i]].assign(line, begin[i], end[i] - begin[i]);
+        }
+
+        if (inferred)
+        {
+            store(entries, line_number);
+            continue;
+        }
+        pending.push_back(make_pair(line_number, entries));
+        if (pending.size() >= max<size_t>(options.infer_rows, 1))
+            infer();
     }
-    dataset._size = dataset.m[dataset.keys.front()].size();
-    data.close();
+
+    if (not inferred)
+        infer();
+    for (auto &&i : types)
+    {
+        dataset._is_numeric.push_back(i != ColumnType::categorical);
+    }
+
     return dataset;
 }
 
 void Dataset::normalize()
 {
+    if (_normalized)
+        return;
     _normalize(this);
+    _normalized = true;
+    for (size_t i = 0; i < _types.size(); i++)
+    {
+        if (_is_numeric[i])
+            _types[i] = ColumnType::float64;
+    }
 }
 
 void Dataset::print()
@@ -241,6 +414,16 @@ void Dataset::set_normalize_function(void (*normalization_function)(Dataset *))
 {
     _normalize = normalization_function;
 }
+ColumnType Dataset::get_type(const string &attribute) const
+{
+    size_t i = find(keys.begin(), keys.end(), attribute) - keys.begin();
+    if (i == keys.size())
+        throw invalid_argument(attribute + " : no such attribute.\n");
+    if (i < _types.size())
+        return _types[i];
+    return _is_numeric[i] ? ColumnType::float64 : ColumnType::categorical;
+}
+
 vector<string> Dataset::get_numerics() const
 {
     vector<string> numerics;
@@ -263,7 +446,7 @@ void Dataset::set_renormalize(void (*renormalize_function)(Dataset *, vector<Dat
     _re_normalize = renormalize_function;
 }
 
-vector<Dataset::DataType> Dataset::iterrow(int at)
+vector<Dataset::DataType> Dataset::iterrow(int at) const
 {
     try
     {
@@ -275,7 +458,7 @@ vector<Dataset::DataType> Dataset::iterrow(int at)
         vector<DataType> data_point;
         for (auto &key : keys)
         {
-            data_point.push_back(m[key][at]);
+            data_point.push_back(m.at(key)[at]);
         }
         return data_point;
     }
@@ -325,16 +508,85 @@ void Dataset::push_back(const vector<DataType> &row)
 
 void Dataset::remove(int at)
 {
-    if (at > _size or at < 0)
+    if (at >= _size or at < 0)
     {
         throw range_error("index out of range.\n");
         return;
     }
     for (size_t i = 0; i < keys.size(); i++)
     {
-        swap(m[keys[i]][i], m[keys[i]].back());
+        swap(m[keys[i]][at], m[keys[i]].back());
         m[keys[i]].pop_back();
     }
+    --_size;
+}
+
+void Dataset::resize(int rows)
+{
+    for (auto &key : keys)
+    {
+        m[key].resize(rows);
+    }
+    _size = rows;
+}
+
+void Dataset::set_row(int at, const vector<DataType> &row)
+{
+    if (at >= _size or at < 0)
+    {
+        throw range_error("index out of range.\n");
+        return;
+    }
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        m[keys[i]][at] = row[i];
+    }
+}
+
+vector<Dataset> Dataset::partition(int n) const
+{
+    if (n <= 0)
+    {
+        throw range_error("the number of shards should be > 0.\n");
+    }
+
+    vector<Dataset> shards(n, structure());
+    for (int i = 0; i < _size; i++)
+    {
+        shards[i % n].push_back(iterrow(i));
+    }
+    return shards;
+}
+
+Dataset Dataset::structure() const
+{
+    Dataset dataset(_normalize, _re_normalize);
+    dataset.local_parms = local_parms;
+    dataset.keys = keys;
+    dataset.label = label;
+    dataset._is_numeric = _is_numeric;
+    dataset._types = _types;
+    dataset._normalized = _normalized;
+    for (auto &key : keys)
+    {
+        dataset.m.insert(make_pair(key, vector<DataType>()));
+    }
+    return dataset;
+}
+
+void Dataset::rescale(const string &attribute, double min, double max)
+{
+    double old_min = get<double>(local_parms.at(attribute + " nmin")),
+           old_max = get<double>(local_parms.at(attribute + " nmax"));
+
+    for (auto &i : m[attribute])
+    {
+        double original = get<double>(i) * (old_max - old_min) + old_min;
+        i = (original - min) / (max - min);
+    }
+
+    local_parms[attribute + " nmin"] = min;
+    local_parms[attribute + " nmax"] = max;
 }
 void Dataset::split(Dataset &train, Dataset &test, double ratio)
 {
@@ -346,6 +598,7 @@ void Dataset::split(Dataset &train, Dataset &test, double ratio)
 
     test.keys = train.keys = keys;
     test._is_numeric = train._is_numeric = _is_numeric;
+    test._types = train._types = _types;
     test.label = train.label = label;
     vector<int> indicies(_size);
     iota(indicies.begin(), indicies.end(), 0);
@@ -367,7 +620,13 @@ void Dataset::split(Dataset &train, Dataset &test, double ratio)
 
 void Dataset::to_csv(const string &path)
 {
-    ofstream output(path, ios::ios_base::out);
+    auto stream = open_output(path);
+    if (not stream)
+    {
+        cerr << path << " : No such file or the path is incorrect";
+        return;
+    }
+    ostream &output = *stream;
     for (size_t i = 0; i < keys.size(); i++)
     {
         if (i == keys.size() - 1)
@@ -412,6 +671,222 @@ void Dataset::to_csv(const string &path)
     }
 }
 
+void Dataset::save_binary(const string &path) const
+{
+    ofstream output(path, ios::binary | ios::out | ios::trunc);
+    if (not output.is_open())
+    {
+        cerr << path << " : No such file or the path is incorrect";
+        return;
+    }
+
+    output.write(binary_magic, sizeof(binary_magic));
+    write_pod<uint32_t>(output, binary_version);
+    write_pod<uint32_t>(output, keys.size());
+    write_pod<uint64_t>(output, _size);
+
+    write_string(output, label);
+    write_pod<uint8_t>(output, _normalized);
+    write_pod<uint32_t>(output, local_parms.size());
+    for (auto &&i : local_parms)
+    {
+        write_value(output, i.first);
+        write_value(output, i.second);
+    }
+
+    // the block offsets are patched once the blocks are written.
+    vector<streampos> offsets;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        write_string(output, keys[i]);
+        write_pod<uint8_t>(output, (uint8_t)get_type(keys[i]));
+        offsets.push_back(output.tellp());
+        write_pod<uint64_t>(output, 0);
+        write_pod<uint64_t>(output, 0);
+    }
+
+    vector<pair<uint64_t, uint64_t>> blocks;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        auto &column = m.at(keys[i]);
+        if (_is_numeric[i])
+        {
+            align(output);
+            blocks.push_back(make_pair((uint64_t)output.tellp(), 0));
+            for (auto &&j : column)
+            {
+                write_pod<double>(output, get<double>(j));
+            }
+            continue;
+        }
+
+        unordered_map<string, uint32_t> codes;
+        vector<const string *> dictionary;
+        vector<uint32_t> encoded;
+        for (auto &&j : column)
+        {
+            auto code = codes.insert(make_pair(get<string>(j), (uint32_t)dictionary.size()));
+            if (code.second)
+                dictionary.push_back(&code.first->first);
+            encoded.push_back(code.first->second);
+        }
+
+        align(output);
+        uint64_t dictionary_offset = output.tellp();
+        write_pod<uint32_t>(output, dictionary.size());
+        for (auto &&j : dictionary)
+        {
+            write_string(output, *j);
+        }
+
+        align(output);
+        blocks.push_back(make_pair((uint64_t)output.tellp(), dictionary_offset));
+        output.write(reinterpret_cast<const char *>(encoded.data()), encoded.size() * sizeof(uint32_t));
+    }
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        output.seekp(offsets[i]);
+        write_pod<uint64_t>(output, blocks[i].first);
+        write_pod<uint64_t>(output, blocks[i].second);
+    }
+}
+
+Dataset Dataset::load_binary(const string &path)
+{
+    Dataset dataset;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 or fstat(fd, &status) < 0)
+    {
+        cerr << path << " : No such file or the path is incorrect";
+        if (fd >= 0)
+            close(fd);
+        return dataset;
+    }
+
+    size_t size = status.st_size;
+    void *mapping = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED or size < sizeof(binary_magic) + 16 or not equal(binary_magic, binary_magic + 8, (const char *)mapping))
+    {
+        cerr << path << " : not a binary dataset file.\n";
+        if (mapping != MAP_FAILED)
+            munmap(mapping, size);
+        return dataset;
+    }
+
+    const char *base = (const char *)mapping, *cursor = base + sizeof(binary_magic);
+    // every count and offset is checked against the mapping before it is followed.
+    auto corrupt = [&]()
+    {
+        throw invalid_argument(path + " : the binary dataset file is truncated or corrupt.\n");
+    };
+    auto need = [&](const char *at, uint64_t bytes)
+    {
+        if (at < base or uint64_t(at - base) > size or bytes > size - (at - base))
+            corrupt();
+    };
+    auto string_at = [&](const char *&at)
+    {
+        need(at, sizeof(uint32_t));
+        uint32_t length;
+        memcpy(&length, at, sizeof(length));
+        need(at + sizeof(uint32_t), length);
+        return read_string(at);
+    };
+    auto value_at = [&](const char *&at) -> Dataset::DataType
+    {
+        need(at, sizeof(uint8_t));
+        if (read_pod<uint8_t>(at))
+            return string_at(at);
+        need(at, sizeof(double));
+        return read_pod<double>(at);
+    };
+
+    try
+    {
+        uint32_t version = read_pod<uint32_t>(cursor), columns = read_pod<uint32_t>(cursor);
+        uint64_t rows = read_pod<uint64_t>(cursor);
+
+        if (version == 0 or version > binary_version)
+        {
+            cerr << path << " : unsupported binary dataset version " << version << ".\n";
+            munmap(mapping, size);
+            return dataset;
+        }
+
+        dataset.label = string_at(cursor);
+        need(cursor, sizeof(uint8_t) + sizeof(uint32_t));
+        dataset._normalized = read_pod<uint8_t>(cursor);
+        for (uint32_t i = read_pod<uint32_t>(cursor); i > 0; i--)
+        {
+            auto key = value_at(cursor);
+            dataset.local_parms[key] = value_at(cursor);
+        }
+
+        for (uint32_t i = 0; i < columns; i++)
+        {
+            dataset.keys.push_back(string_at(cursor));
+            need(cursor, sizeof(uint8_t) + 2 * sizeof(uint64_t));
+            uint8_t type = read_pod<uint8_t>(cursor);
+            if (version > 1 and type > (uint8_t)ColumnType::categorical)
+                corrupt();
+            ColumnType column_type = version == 1 ? (type ? ColumnType::categorical : ColumnType::float64) : (ColumnType)type;
+            bool categorical = column_type == ColumnType::categorical;
+            uint64_t offset = read_pod<uint64_t>(cursor), dictionary_offset = read_pod<uint64_t>(cursor);
+            dataset._is_numeric.push_back(not categorical);
+            dataset._types.push_back(column_type);
+
+            auto &column = dataset.m[dataset.keys.back()];
+            size_t width = categorical ? sizeof(uint32_t) : sizeof(double);
+            if (rows > size / width or offset > size)
+                corrupt();
+            need(base + offset, rows * width);
+            column.reserve(rows);
+
+            if (not categorical)
+            {
+                const double *values = (const double *)(base + offset);
+                column.assign(values, values + rows);
+                continue;
+            }
+
+            if (dictionary_offset > size)
+                corrupt();
+            const char *page = base + dictionary_offset;
+            need(page, sizeof(uint32_t));
+            uint32_t entries = read_pod<uint32_t>(page);
+            // every entry takes at least its length prefix.
+            need(page, uint64_t(entries) * sizeof(uint32_t));
+            vector<Dataset::DataType> dictionary(entries);
+            for (auto &&j : dictionary)
+            {
+                j = string_at(page);
+            }
+
+            const uint32_t *codes = (const uint32_t *)(base + offset);
+            for (uint64_t j = 0; j < rows; j++)
+            {
+                if (codes[j] >= dictionary.size())
+                    corrupt();
+                column.push_back(dictionary[codes[j]]);
+            }
+        }
+
+        dataset._size = rows;
+    }
+    catch (...)
+    {
+        munmap(mapping, size);
+        throw;
+    }
+
+    munmap(mapping, size);
+    return dataset;
+}
+
 bool Dataset::has_attribute(const string &attribute)
 {
     for (size_t i = 0; i < keys.size(); i++)
@@ -442,13 +917,13 @@ ostream &operator<<(ostream &out, const Dataset::DataType &a)
     return out;
 }
 
-bool Dataset::is_normalized(const vector<Dataset::DataType>& data_point)
+bool Dataset::is_normalized(const vector<Dataset::DataType>& data_point) const
 {
     for (size_t i = 0; i < keys.size(); i++)
     {
         if (_is_numeric[i])
         {
-            if (get<double>(data_point[i]) > get<double>(local_parms[keys[i] + " nmax"]) or get<double>(data_point[i]) < get<double>(local_parms[DataType(keys[i] + " nmin")]))
+            if (get<double>(data_point[i]) > get<double>(local_parms.at(keys[i] + " nmax")) or get<double>(data_point[i]) < get<double>(local_parms.at(keys[i] + " nmin")))
             {
                 return false;
             }
@@ -480,7 +955,79 @@ bool operator!=(const Dataset::DataType &a, const Dataset::DataType &b)
 
 bool is_numeric(const string &str)
 {
-    regex pat(R"(^[-+]?(\d+\.?\d*|\.\d+)$)"); // also we can make other pattern for just integers
-                                              // R"(^[-+]?\d+$)"
-    return regex_match(str, pat);
+    double value;
+    return scan_number(str.data(), str.data() + str.size(), value);
+}
+
+bool scan_number(const char *begin, const char *end, double &value, int *digits)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *p = begin;
+    bool negative = p != end and *p == '-';
+    if (p != end and (*p == '-' or *p == '+'))
+        ++p;
+
+    uint64_t mantissa = 0;
+    int significant = 0, scale = 0, mantissa_digits = 0;
+    bool any = false, leading = true;
+    for (bool fraction = false; p != end; ++p)
+    {
+        if (*p == '.' and not fraction)
+        {
+            fraction = true;
+            continue;
+        }
+        if (*p < '0' or *p > '9')
+            break;
+        any = true;
+        leading = leading and *p == '0';
+        if (leading)
+        {
+            scale -= fraction;
+            continue;
+        }
+        ++significant;
+        if (mantissa_digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            ++mantissa_digits;
+            scale -= fraction;
+        }
+        else
+            scale += not fraction;
+    }
+    if (not any)
+        return false;
+
+    if (p != end and (*p == 'e' or *p == 'E'))
+    {
+        ++p;
+        bool negative_exponent = p != end and *p == '-';
+        if (p != end and (*p == '-' or *p == '+'))
+            ++p;
+        if (p == end)
+            return false;
+        int exponent = 0;
+        for (; p != end and *p >= '0' and *p <= '9'; ++p)
+        {
+            exponent = min(exponent * 10 + (*p - '0'), 100000);
+        }
+        scale += negative_exponent ? -exponent : exponent;
+    }
+    if (p != end)
+        return false;
+
+    if (digits)
+        *digits = significant;
+
+    // exact when the mantissa and the power of ten are both exactly representable, strtod otherwise.
+    if (mantissa < (1ull << 53) and scale >= -22 and scale <= 22 and significant == mantissa_digits)
+    {
+        value = scale < 0 ? mantissa / powers[-scale] : mantissa * powers[scale];
+        value = negative ? -value : value;
+    }
+    else
+        value = strtod(string(begin, end).c_str(), nullptr);
+    return true;
 }
\ No newline at end of file
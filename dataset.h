@@ -22,9 +22,39 @@
 #include <regex>
 #include <algorithm>
 #include <numeric>
+#include <random>
 
 using namespace std;
 
+/**
+ * @brief The storage type of an attribute, from the narrowest numeric type to categorical.
+ */
+enum class ColumnType : uint8_t
+{
+    uint8,
+    int32,
+    float32,
+    float64,
+    categorical
+};
+
+/**
+ * @brief Options that narrow what `read_csv` materializes.
+ *
+ * Fields outside the projection are skipped while tokenizing, without being copied or parsed, and rows are
+ * filtered before any of their values are allocated.
+ */
+struct LoadOptions
+{
+    vector<string> columns;                                      /**< The attributes to keep, in order; empty keeps every attribute. */
+    unordered_map<string, bool (*)(const string &)> predicates; /**< Row filters on the raw text of an attribute, projected or not. */
+    size_t limit = 0;                                            /**< The maximum number of rows to keep; 0 keeps every row. */
+    double sample = 1;                                           /**< The fraction of rows to keep, drawn independently per row. */
+    unsigned seed = 0;                                           /**< The seed of the row sampler. */
+    unordered_map<string, ColumnType> schema;                    /**< Explicit attribute types; the others are inferred. */
+    size_t infer_rows = 100;                                     /**< The number of kept rows sampled to infer the other types. */
+};
+
 /**
  * @brief Represents a dataset with attributes and values, and provides visualization methods.
  */
@@ -73,9 +103,9 @@ public:
             {
                 if (self->_is_numeric[i])
                 {
-                    data_point[i] = (get<double>(data_point[i]) - get<double>(self->local_parms[self->keys[i] + " nmin"])) 
+                    data_point[i] = (get<double>(data_point[i]) - get<double>(self->local_parms.at(self->keys[i] + " nmin"))) 
                     / 
-                    (get<double>(self->local_parms[self->keys[i] + " nmax"]) - get<double>(self->local_parms[self->keys[i] + " nmin"]));
+                    (get<double>(self->local_parms.at(self->keys[i] + " nmax")) - get<double>(self->local_parms.at(self->keys[i] + " nmin")));
                 }
             } });
     /**
@@ -88,13 +118,31 @@ public:
     /**
      * @brief Reads a dataset from a CSV file.
      *
+     * Files ending in `.gz`, `.bz2` or `.zst` are decompressed on the fly by a background thread, so the
+     * compressed drop never has to be inflated to disk first.
+     *
      * @param path The path to the CSV file.
+     * @param options The column projection, row predicates, row limit and sampling rate.
+     * @return The populated Dataset object.
+     */
+    static Dataset read_csv(const string &path, const LoadOptions &options = LoadOptions());
+    /**
+     * @brief Reads a dataset from CSV text on an input stream.
+     *
+     * Attribute types come from the schema in the options, or are inferred from the first `infer_rows` rows that
+     * are kept: the narrowest numeric type holding every sampled value, or categorical. A later value that does
+     * not fit its attribute type is reported with its row and attribute, and the row is skipped.
+     *
+     * @param data The stream holding the header line followed by the rows.
+     * @param options The column projection, row predicates, row limit and sampling rate.
      * @return The populated Dataset object.
      */
-    static Dataset read_csv(const string &path);
+    static Dataset read_csv(istream &data, const LoadOptions &options = LoadOptions());
     /**
      * @brief Normalizes the dataset values using the specified normalization function.
      *
+     * Normalizing an already normalized dataset does nothing, so a dataset normalized once (e.g. before being
+     * partitioned) keeps its bounds.
      */
     void normalize();
     /**
@@ -169,6 +217,16 @@ public:
      * @return A vector of strings containing the names of the numeric attributes.
      */
     vector<string> get_numerics() const;
+    /**
+     * @brief Retrieves the storage type of an attribute.
+     *
+     * Integer and float32 types describe the raw values; once the dataset is normalized its numeric attributes
+     * are reported as float64.
+     *
+     * @param attribute The name of the attribute.
+     * @return The storage type of the attribute.
+     */
+    ColumnType get_type(const string &attribute) const;
 
     /**
      * @brief Applies renormalization to a data point using the specified renormalization function.
@@ -192,7 +250,7 @@ public:
      * @param at The index of the data point to retrieve.
      * @return A vector containing the values of the data point.
      */
-    vector<DataType> iterrow(int at);
+    vector<DataType> iterrow(int at) const;
 
     /**
      * @brief Retrieves a data point at a specific index by reference.
@@ -234,6 +292,61 @@ public:
      */
     void remove(int at);
 
+    /**
+     * @brief Change the number of rows of the dataset.
+     *
+     * Every attribute's vector is resized; new rows are filled with 0.0 and are meant to be
+     * overwritten with `set_row`. Useful to preallocate storage.
+     *
+     * @param rows The new number of rows.
+     */
+    void resize(int rows);
+
+    /**
+     * @brief Overwrite the data point at the specified index in place.
+     *
+     * @param at The index of the data point to overwrite.
+     * @param row A vector containing attribute values for the data point.
+     *
+     * @note If the index is outside the valid range [0, _size - 1], a range_error is thrown.
+     */
+    void set_row(int at, const vector<DataType> &row);
+
+    /**
+     * @brief Partition the dataset into disjoint shards.
+     *
+     * Rows are dealt round-robin. Every shard keeps the attributes, label, normalization parameters and
+     * functions of this dataset, so shards of a normalized dataset share its bounds.
+     *
+     * @param n The number of shards.
+     * @return The shards.
+     */
+    vector<Dataset> partition(int n) const;
+
+    /**
+     * @brief Construct an empty dataset with the same structure as this one.
+     *
+     * The returned dataset has the same attributes, label, normalization parameters and
+     * normalization/renormalization functions, but no rows.
+     *
+     * @return An empty dataset sharing this dataset's structure.
+     */
+    Dataset structure() const;
+
+    /**
+     * @brief Re-express a range-normalized numeric attribute against new bounds.
+     *
+     * Every value of the attribute is mapped back to its original scale using the current bounds
+     * and normalized again against [min, max]; the stored bounds are updated accordingly.
+     *
+     * @param attribute The numeric attribute to rescale.
+     * @param min The new lower bound (original scale).
+     * @param max The new upper bound (original scale).
+     *
+     * @note Only meaningful with the default range transformation normalization.
+     */
+    void rescale(const string &attribute, double min, double max);
+
     /**
      * @brief Split the dataset into training and testing datasets based on a given ratio.
      *
@@ -253,10 +366,36 @@ public:
      * This function constructs a CSV (Comma-Separated Values) representation of the dataset and saves it to a file specified by the provided path.
      * The CSV file will have the attribute names as the header row and the corresponding attribute values for each data point.
      *
+     * Paths ending in `.gz`, `.bz2` or `.zst` are compressed with the matching codec while writing.
+     *
      * @param path The path to the CSV file where the dataset's CSV representation will be saved.
      */
     void to_csv(const string &path);
 
+    /**
+     * @brief Save the dataset to a versioned, column-oriented binary file.
+     *
+     * The file holds a schema header (attributes, types, label, normalization parameters) followed by one block
+     * per column: doubles for numeric attributes, and a dictionary page plus uint32 codes for categorical ones.
+     * Blocks are 64-byte aligned so they can be used in place once the file is memory-mapped. Values round-trip
+     * exactly, with no text conversion.
+     *
+     * @param path The path to the binary file.
+     */
+    void save_binary(const string &path) const;
+
+    /**
+     * @brief Load a dataset saved with `save_binary`.
+     *
+     * The file is memory-mapped and the column blocks are read in place, without parsing or type inference.
+     * Normalization and renormalization functions are not stored; the defaults are used.
+     *
+     * @param path The path to the binary file.
+     * @return The populated Dataset object.
+     * @throw invalid_argument If the file is truncated or an offset, size or dictionary code in it is out of range.
+     */
+    static Dataset load_binary(const string &path);
+
     /**
      * @brief Checks if a given data point is normalized within the specified bounds.
      *
@@ -265,16 +404,18 @@ public:
      * @param data_point The data point to check for normalization.
      * @return true if the data point is normalized, false otherwise.
      */
-    bool is_normalized(const vector<DataType> &data_point);
+    bool is_normalized(const vector<DataType> &data_point) const;
 
 private:
     unordered_map<string, vector<DataType>> m;            /**< Map storing attribute values for the dataset. */
     vector<string> keys;                                  /**< Vector containing the names of attributes. */
     string label;                                         /**< The label attribute for the dataset. */
     vector<bool> _is_numeric;                             /**< Vector indicating whether each attribute is numeric. */
+    vector<ColumnType> _types;                            /**< The storage type of each attribute. */
     int _size;                                            /**< The number of rows in the dataset. */
     void (*_normalize)(Dataset *);                        /**< Pointer to the normalization function. */
     void (*_re_normalize)(Dataset *, vector<DataType> &); /**< Pointer to the renormalization function. */
+    bool _normalized = false;                             /**< Whether the dataset values have been normalized. */
 
     /**
      * @brief Checks if the dataset has a specific attribute.
@@ -292,6 +433,17 @@ private:
  */
 bool is_numeric(const string &str);
 
+/**
+ * @brief Parses a decimal number, with an optional sign, fraction and exponent, spanning the whole range.
+ *
+ * @param begin The first character of the text.
+ * @param end One past the last character of the text.
+ * @param value Receives the parsed value.
+ * @param digits Receives the number of significant digits, if not null.
+ * @return true if the whole range is a number, false otherwise.
+ */
+bool scan_number(const char *begin, const char *end, double &value, int *digits = nullptr);
+
 /**
  * @brief Overloaded stream insertion operator for Dataset::DataType values.
  *
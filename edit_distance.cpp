@@ -0,0 +1,114 @@
+#include "edit_distance.h"
+#include "string_similarity.h"
+
+namespace
+{
+    /**
+     * @brief Dynamic program, for patterns longer than a machine word.
+     */
+    int edit_distance_dp(const u32string &a, const u32string &b, bool transpositions)
+    {
+        vector<vector<int>> d(a.size() + 1, vector<int>(b.size() + 1));
+
+        for (size_t i = 0; i <= a.size(); i++)
+            d[i][0] = i;
+        for (size_t j = 0; j <= b.size(); j++)
+            d[0][j] = j;
+
+        for (size_t i = 1; i <= a.size(); i++)
+        {
+            for (size_t j = 1; j <= b.size(); j++)
+            {
+                d[i][j] = min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + (a[i - 1] != b[j - 1])});
+                if (transpositions and i > 1 and j > 1 and a[i - 1] == b[j - 2] and a[i - 2] == b[j - 1])
+                    d[i][j] = min(d[i][j], d[i - 2][j - 2] + 1);
+            }
+        }
+        return d[a.size()][b.size()];
+    }
+
+    /**
+     * @brief Myers/Hyyrö bit-parallel edit distance; the pattern must hold at most 64 codepoints.
+     */
+    int edit_distance_bits(const u32string &pattern, const u32string &text, bool transpositions)
+    {
+        int m = pattern.size();
+        if (m == 0)
+            return text.size();
+
+        // match masks of the pattern's codepoints, sorted for binary search.
+        vector<pair<char32_t, uint64_t>> peq;
+        for (int i = 0; i < m; i++)
+            peq.push_back(make_pair(pattern[i], 1ull << i));
+        sort(peq.begin(), peq.end());
+        size_t n = 0;
+        for (size_t i = 0; i < peq.size(); i++)
+        {
+            if (n > 0 and peq[n - 1].first == peq[i].first)
+                peq[n - 1].second |= peq[i].second;
+            else
+                peq[n++] = peq[i];
+        }
+        peq.resize(n);
+
+        uint64_t vp = ~0ull, vn = 0, d0 = 0, pm_previous = 0, last = 1ull << (m - 1);
+        int score = m;
+
+        for (auto &&c : text)
+        {
+            auto match = lower_bound(peq.begin(), peq.end(), make_pair(c, (uint64_t)0));
+            uint64_t pm = (match != peq.end() and match->first == c) ? match->second : 0;
+
+            uint64_t tr = transpositions ? (((~d0) & pm) << 1) & pm_previous : 0;
+            d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+            uint64_t hp = vn | ~(d0 | vp), hn = d0 & vp;
+
+            if (hp & last)
+                ++score;
+            else if (hn & last)
+                --score;
+
+            hp = (hp << 1) | 1;
+            hn <<= 1;
+            vp = hn | ~(d0 | hp);
+            vn = d0 & hp;
+            pm_previous = pm;
+        }
+        return score;
+    }
+
+    int edit_distance(const u32string &a, const u32string &b, bool transpositions)
+    {
+        // the shorter string is the pattern; both distances are symmetric.
+        const u32string &pattern = a.size() <= b.size() ? a : b, &text = a.size() <= b.size() ? b : a;
+        if (pattern.size() > 64)
+            return edit_distance_dp(pattern, text, transpositions);
+        return edit_distance_bits(pattern, text, transpositions);
+    }
+
+    double sum_distances(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b, bool transpositions)
+    {
+        return sum_string_distances(self, a, b, [transpositions](const string &x, const string &y)
+                                    { return edit_distance(decode_utf8(x), decode_utf8(y), transpositions); });
+    }
+}
+
+int levenshtein_distance(const u32string &a, const u32string &b)
+{
+    return edit_distance(a, b, false);
+}
+
+int damerau_distance(const u32string &a, const u32string &b)
+{
+    return edit_distance(a, b, true);
+}
+
+double levenshtein_distance_mesure(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b)
+{
+    return sum_distances(self, a, b, false);
+}
+
+double damerau_distance_mesure(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b)
+{
+    return sum_distances(self, a, b, true);
+}
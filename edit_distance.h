@@ -0,0 +1,40 @@
+#ifndef H_EDIT_DISTANCE
+#define H_EDIT_DISTANCE
+/**
+ * @file edit_distance.cpp
+ * @brief Implementation of bit-parallel edit distances over codepoints and the matching proximity measures.
+ *
+ * This file contains Levenshtein and Damerau (optimal string alignment) distances computed with Myers' bit-parallel
+ * algorithm, in Hyyrö's formulation with the transposition extension, on decoded codepoints rather than bytes.
+ * Strings up to 64 codepoints fit a single machine word; longer ones fall back to the dynamic program.
+ */
+
+#include "dataset.h"
+#include <cstdint>
+
+/**
+ * @brief Levenshtein distance between two codepoint strings.
+ *
+ * @return The minimum number of insertions, deletions and substitutions turning a into b.
+ */
+int levenshtein_distance(const u32string &a, const u32string &b);
+
+/**
+ * @brief Damerau distance (optimal string alignment) between two codepoint strings.
+ *
+ * @return The minimum number of insertions, deletions, substitutions and transpositions of adjacent characters
+ * turning a into b, no substring being edited twice.
+ */
+int damerau_distance(const u32string &a, const u32string &b);
+
+/**
+ * @brief Sum of the Levenshtein distances over the categorical attributes, the label excluded.
+ */
+double levenshtein_distance_mesure(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &);
+
+/**
+ * @brief Sum of the Damerau (optimal string alignment) distances over the categorical attributes, the label excluded.
+ */
+double damerau_distance_mesure(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &);
+
+#endif
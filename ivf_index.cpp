@@ -0,0 +1,192 @@
+#include "ivf_index.h"
+#include "binary_io.h"
+#include <queue>
+#include <random>
+#include <cmath>
+
+namespace
+{
+    const char ivf_magic[8] = {'K', 'N', 'N', 'I', 'V', 'F', 0, 0};
+    const uint32_t ivf_version = 1;
+}
+
+IVFIndex::IVFIndex(unsigned int lists, unsigned int nprobe, unsigned int refine, unsigned int train_sample)
+    : _lists{lists}, _nprobe{max(nprobe, 1u)}, _refine{refine}, _train_sample{max(train_sample, 1u)}, _centroids(1)
+{
+}
+
+void IVFIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != dataset.get_label() and find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            _attributes.push_back(i);
+    }
+
+    _rows = dataset.no_rows();
+    size_t dim = _attributes.size();
+    vector<float> data(_rows * dim);
+    for (size_t j = 0; j < dim; j++)
+    {
+        auto &values = dataset[keys[_attributes[j]]];
+        for (int i = 0; i < _rows; i++)
+        {
+            data[i * dim + j] = get<double>(values[i]);
+        }
+    }
+
+    vector<size_t> order(_rows);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), mt19937(0));
+    order.resize(min<size_t>(order.size(), _train_sample));
+    vector<float> sample(order.size() * dim);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        copy(data.begin() + order[i] * dim, data.begin() + (order[i] + 1) * dim, sample.begin() + i * dim);
+    }
+
+    _centroids = KMeans(_lists ? _lists : max<size_t>(sqrt((double)_rows), 1));
+    _centroids.fit(sample.data(), order.size(), dim);
+
+    // counting sort of the rows by list, so each list is one contiguous block.
+    auto row_lists = _centroids.assign(data.data(), _rows);
+    _offsets.assign(_centroids.size() + 1, 0);
+    for (auto &&i : row_lists)
+    {
+        _offsets[i + 1]++;
+    }
+    partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+    _ids.assign(_rows, 0);
+    _vectors.assign(_rows * dim, 0);
+    vector<uint64_t> next(_offsets.begin(), _offsets.end() - 1);
+    for (int i = 0; i < _rows; i++)
+    {
+        uint64_t at = next[row_lists[i]]++;
+        _ids[at] = i;
+        copy(data.begin() + i * dim, data.begin() + (i + 1) * dim, _vectors.begin() + at * dim);
+    }
+}
+
+vector<pair<double, int>> IVFIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    return search(dataset, target, k, proximity_measure, 0);
+}
+
+vector<pair<double, int>> IVFIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int nprobe) const
+{
+    if (_rows == 0 or k == 0)
+        return {};
+
+    size_t dim = _attributes.size();
+    vector<float> query(dim);
+    for (size_t j = 0; j < dim; j++)
+    {
+        query[j] = get<double>(target[column(dataset, target, _attributes[j])]);
+    }
+
+    vector<pair<float, uint32_t>> lists;
+    auto distances = _centroids.distances(query.data());
+    for (size_t c = 0; c < distances.size(); c++)
+    {
+        lists.push_back(make_pair(distances[c], c));
+    }
+    nprobe = min<size_t>(nprobe ? nprobe : _nprobe.load(), lists.size());
+    partial_sort(lists.begin(), lists.begin() + nprobe, lists.end());
+
+    size_t fetch = _refine ? (size_t)k * _refine : k;
+    priority_queue<pair<float, int>> best; // a max-heap of the best rows so far.
+    for (unsigned int p = 0; p < nprobe; p++)
+    {
+        uint32_t c = lists[p].second;
+        for (uint64_t e = _offsets[c]; e < _offsets[c + 1]; e++)
+        {
+            float distance = squared_l2(query.data(), _vectors.data() + e * dim, dim);
+            if (best.size() < fetch)
+                best.push(make_pair(distance, _ids[e]));
+            else if (distance < best.top().first)
+            {
+                best.pop();
+                best.push(make_pair(distance, _ids[e]));
+            }
+        }
+    }
+
+    vector<pair<double, int>> res;
+    vector<int> candidates;
+    for (; not best.empty(); best.pop())
+    {
+        res.push_back(make_pair(sqrt(best.top().first), best.top().second));
+        candidates.push_back(best.top().second);
+    }
+    if (_refine)
+        return rerank(dataset, target, candidates, k, proximity_measure);
+
+    reverse(res.begin(), res.end());
+    return res;
+}
+
+shared_ptr<SearchIndex> IVFIndex::clone() const
+{
+    return make_shared<IVFIndex>(_lists, _nprobe, _refine, _train_sample);
+}
+
+bool IVFIndex::save(ostream &out) const
+{
+    out.write(ivf_magic, sizeof(ivf_magic));
+    write_pod<uint32_t>(out, ivf_version);
+    write_pod<uint32_t>(out, _nprobe);
+    write_pod<uint32_t>(out, _refine);
+    write_pod<int32_t>(out, _rows);
+    write_vector(out, vector<int32_t>(_attributes.begin(), _attributes.end()));
+    _centroids.save(out);
+    write_vector(out, _offsets);
+    write_vector(out, _ids);
+    write_vector(out, _vectors);
+    return bool(out);
+}
+
+bool IVFIndex::load(istream &in, Dataset &dataset)
+{
+    char magic[sizeof(ivf_magic)] = {};
+    in.read(magic, sizeof(magic));
+    if (not equal(magic, magic + sizeof(magic), ivf_magic) or read_pod<uint32_t>(in) != ivf_version)
+        return false;
+
+    _nprobe = max(read_pod<uint32_t>(in), 1u);
+    _refine = read_pod<uint32_t>(in);
+    _rows = read_pod<int32_t>(in);
+    auto attributes = read_vector<int32_t>(in);
+    _attributes.assign(attributes.begin(), attributes.end());
+    _centroids.load(in);
+    _offsets = read_vector<uint64_t>(in);
+    _ids = read_vector<int32_t>(in);
+    _vectors = read_vector<float>(in);
+    if (not in or _rows != dataset.no_rows() or not valid_attributes(dataset, _attributes))
+        return false;
+
+    // the lists are walked straight from these, so a corrupt file must not reach a search.
+    size_t dim = _attributes.size();
+    if (_centroids.centroids().size() != _centroids.size() * dim or _offsets.size() != _centroids.size() + 1 or
+        _offsets.front() != 0 or _offsets.back() != (uint64_t)_rows or not is_sorted(_offsets.begin(), _offsets.end()) or
+        _ids.size() != (size_t)_rows or _vectors.size() != _rows * dim)
+        return false;
+    return all_of(_ids.begin(), _ids.end(), [this](int32_t i)
+                  { return i >= 0 and i < _rows; });
+}
+
+void IVFIndex::set_nprobe(unsigned int nprobe)
+{
+    _nprobe = max(nprobe, 1u);
+}
+
+size_t IVFIndex::no_lists() const
+{
+    return _centroids.size();
+}
@@ -0,0 +1,89 @@
+#ifndef H_IVF_INDEX
+#define H_IVF_INDEX
+/**
+ * @file ivf_index.cpp
+ * @brief Implementation of an inverted-file (IVF) clustered search index.
+ *
+ * This file contains the implementation of the `IVFIndex` class. The normalized numeric features of the rows are
+ * clustered with k-means into inverted lists, and the feature vectors of each list are stored contiguously. A query
+ * scans only the nprobe lists whose centroids are nearest to it, so the number of lists visited trades recall for
+ * speed, per query if needed.
+ *
+ * Saved file layout: magic "KNNIVF", version, parameters, attribute positions, centroids, and the lists as
+ * offsets, row ids and feature vectors.
+ */
+
+#include "search_index.h"
+#include "kmeans.h"
+#include <cstdint>
+#include <atomic>
+
+/**
+ * @brief An inverted-file index over the normalized numeric features, ranked by Euclidean distance.
+ *
+ * With `refine` set the best `refine * k` rows of the probed lists are reranked with the exact proximity measure,
+ * which also accounts for categorical attributes; with `refine` 0 their Euclidean distances are returned.
+ */
+class IVFIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs an IVF index.
+     *
+     * @param lists The number of inverted lists, 0 for sqrt(rows) (default is 0).
+     * @param nprobe The number of lists visited per query (default is 8).
+     * @param refine The number of candidates reranked exactly, as a multiple of k, 0 to skip (default is 2).
+     * @param train_sample The number of rows the centroids are trained on (default is 65536).
+     */
+    IVFIndex(unsigned int lists = 0, unsigned int nprobe = 8, unsigned int refine = 2, unsigned int train_sample = 1 << 16);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    /**
+     * @brief Find the k nearest neighbors of a target, visiting a given number of lists.
+     *
+     * Reached from `KNN::predict` and `KNN::first_knn` through their nprobe argument.
+     *
+     * @param nprobe The number of lists to visit for this query, 0 for the index's setting.
+     */
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int nprobe) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+    bool save(ostream &out) const override;
+
+    bool load(istream &in, Dataset &dataset) override;
+
+    /**
+     * @brief Set the number of lists visited by queries that do not give their own.
+     *
+     * Safe to call on the live index (`KNN::get_index`) while queries run; later queries use the new value.
+     *
+     * @param nprobe The number of lists.
+     */
+    void set_nprobe(unsigned int nprobe);
+
+    /**
+     * @brief Retrieves the number of inverted lists.
+     */
+    size_t no_lists() const;
+
+private:
+    unsigned int _lists;                 /**< The number of lists asked for. */
+    atomic<unsigned int> _nprobe;        /**< The lists visited by default, changed while queries run. */
+    unsigned int _refine, _train_sample; /**< The parameters. */
+    vector<int> _attributes;             /**< The positions of the numeric, non-label attributes. */
+    int _rows = 0;                       /**< The number of indexed rows. */
+    KMeans _centroids;                   /**< The list centroids. */
+    vector<uint64_t> _offsets;           /**< The first entry of each list, plus the end. */
+    vector<int32_t> _ids;                /**< The row of each entry, grouped by list. */
+    vector<float> _vectors;              /**< The feature vector of each entry, grouped by list. */
+};
+
+#endif
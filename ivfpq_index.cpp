@@ -0,0 +1,292 @@
+#include "ivfpq_index.h"
+#include "binary_io.h"
+#include <queue>
+#include <random>
+#include <thread>
+#include <cmath>
+
+namespace
+{
+    const char ivfpq_magic[8] = {'K', 'N', 'N', 'I', 'V', 'F', 'P', 'Q'};
+    const uint32_t ivfpq_version = 1;
+    const size_t codebook_size = 256;
+}
+
+IVFPQIndex::IVFPQIndex(unsigned int lists, unsigned int subspaces, unsigned int nprobe, unsigned int refine, unsigned int train_sample)
+    : _lists{lists}, _subspaces{subspaces}, _nprobe{max(nprobe, 1u)}, _refine{refine}, _train_sample{max(train_sample, 1u)}, _coarse(1)
+{
+}
+
+void IVFPQIndex::features(const Dataset &dataset, const vector<Dataset::DataType> &data_point, float *out) const
+{
+    fill(out, out + _codebooks.size() * _dsub, 0.0f);
+    for (size_t j = 0; j < _attributes.size(); j++)
+    {
+        out[j] = get<double>(data_point[column(dataset, data_point, _attributes[j])]);
+    }
+}
+
+void IVFPQIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != dataset.get_label() and find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            _attributes.push_back(i);
+    }
+
+    _rows = dataset.no_rows();
+    size_t d = _attributes.size();
+    size_t m = _subspaces ? min<size_t>(_subspaces, max<size_t>(d, 1)) : max<size_t>((d + 1) / 2, 1);
+    _dsub = max<size_t>((d + m - 1) / m, 1);
+    size_t dim = m * _dsub;
+
+    vector<float> data(_rows * dim, 0.0f);
+    for (size_t j = 0; j < d; j++)
+    {
+        auto &values = dataset[keys[_attributes[j]]];
+        for (int i = 0; i < _rows; i++)
+        {
+            data[i * dim + j] = get<double>(values[i]);
+        }
+    }
+
+    // the quantizers are trained on a random sample of the rows.
+    vector<size_t> order(_rows);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), mt19937(0));
+    order.resize(min<size_t>(order.size(), _train_sample));
+    vector<float> sample(order.size() * dim);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        copy(data.begin() + order[i] * dim, data.begin() + (order[i] + 1) * dim, sample.begin() + i * dim);
+    }
+
+    size_t lists = _lists ? _lists : max<size_t>(sqrt((double)_rows), 1);
+    _coarse = KMeans(lists);
+    _coarse.fit(sample.data(), order.size(), dim);
+
+    auto sample_lists = _coarse.assign(sample.data(), order.size());
+    _codebooks.assign(m, KMeans(codebook_size));
+    vector<float> subvectors(order.size() * _dsub);
+    for (size_t j = 0; j < m; j++)
+    {
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            for (size_t l = 0; l < _dsub; l++)
+            {
+                subvectors[i * _dsub + l] = sample[i * dim + j * _dsub + l] - _coarse.centroids()[sample_lists[i] * dim + j * _dsub + l];
+            }
+        }
+        _codebooks[j].fit(subvectors.data(), order.size(), _dsub);
+    }
+
+    // encode every row, then lay the lists out contiguously.
+    auto row_lists = _coarse.assign(data.data(), _rows);
+    vector<uint8_t> codes(_rows * m);
+    unsigned int threads = max<size_t>(min<size_t>(thread::hardware_concurrency(), (_rows + 1023) / 1024), 1);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            vector<float> residual(dim);
+            for (size_t i = (size_t)_rows * t / threads; i < (size_t)_rows * (t + 1) / threads; i++)
+            {
+                for (size_t l = 0; l < dim; l++)
+                {
+                    residual[l] = data[i * dim + l] - _coarse.centroids()[row_lists[i] * dim + l];
+                }
+                for (size_t j = 0; j < m; j++)
+                {
+                    codes[i * m + j] = _codebooks[j].nearest(residual.data() + j * _dsub);
+                }
+            } });
+    }
+    for (auto &&i : workers)
+    {
+        i.join();
+    }
+
+    _offsets.assign(_coarse.size() + 1, 0);
+    for (auto &&i : row_lists)
+    {
+        _offsets[i + 1]++;
+    }
+    partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+    _ids.assign(_rows, 0);
+    _codes.assign(_rows * m, 0);
+    vector<uint64_t> next(_offsets.begin(), _offsets.end() - 1);
+    for (int i = 0; i < _rows; i++)
+    {
+        uint64_t at = next[row_lists[i]]++;
+        _ids[at] = i;
+        copy(codes.begin() + i * m, codes.begin() + (i + 1) * m, _codes.begin() + at * m);
+    }
+}
+
+vector<pair<double, int>> IVFPQIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    return search(dataset, target, k, proximity_measure, 0);
+}
+
+vector<pair<double, int>> IVFPQIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int nprobe) const
+{
+    size_t m = _codebooks.size(), dim = m * _dsub;
+    if (_rows == 0 or k == 0)
+        return {};
+
+    vector<float> query(dim);
+    features(dataset, target, query.data());
+
+    vector<pair<float, uint32_t>> lists;
+    auto coarse_distances = _coarse.distances(query.data());
+    for (size_t c = 0; c < coarse_distances.size(); c++)
+    {
+        lists.push_back(make_pair(coarse_distances[c], c));
+    }
+    nprobe = min<size_t>(nprobe ? nprobe : _nprobe.load(), lists.size());
+    partial_sort(lists.begin(), lists.begin() + nprobe, lists.end());
+
+    size_t fetch = _refine ? (size_t)k * _refine : k;
+    priority_queue<pair<float, int>> best; // a max-heap of the best rows so far.
+    vector<float> residual(dim), table(m * codebook_size);
+    for (unsigned int p = 0; p < nprobe; p++)
+    {
+        uint32_t c = lists[p].second;
+        for (size_t l = 0; l < dim; l++)
+        {
+            residual[l] = query[l] - _coarse.centroids()[c * dim + l];
+        }
+
+        // the distance of every codeword to the residual, so a row costs m lookups.
+        for (size_t j = 0; j < m; j++)
+        {
+            auto distances = _codebooks[j].distances(residual.data() + j * _dsub);
+            copy(distances.begin(), distances.end(), table.begin() + j * codebook_size);
+        }
+
+        for (uint64_t e = _offsets[c]; e < _offsets[c + 1]; e++)
+        {
+            const uint8_t *code = _codes.data() + e * m;
+            float distance = 0;
+            for (size_t j = 0; j < m; j++)
+            {
+                distance += table[j * codebook_size + code[j]];
+            }
+            if (best.size() < fetch)
+                best.push(make_pair(distance, _ids[e]));
+            else if (distance < best.top().first)
+            {
+                best.pop();
+                best.push(make_pair(distance, _ids[e]));
+            }
+        }
+    }
+
+    vector<pair<double, int>> res;
+    vector<int> candidates;
+    for (; not best.empty(); best.pop())
+    {
+        res.push_back(make_pair(sqrt(max(best.top().first, 0.0f)), best.top().second));
+        candidates.push_back(best.top().second);
+    }
+    if (_refine)
+        return rerank(dataset, target, candidates, k, proximity_measure);
+
+    reverse(res.begin(), res.end());
+    return res;
+}
+
+shared_ptr<SearchIndex> IVFPQIndex::clone() const
+{
+    return make_shared<IVFPQIndex>(_lists, _subspaces, _nprobe, _refine, _train_sample);
+}
+
+bool IVFPQIndex::save(ostream &out) const
+{
+    out.write(ivfpq_magic, sizeof(ivfpq_magic));
+    write_pod<uint32_t>(out, ivfpq_version);
+    write_pod<uint32_t>(out, _nprobe);
+    write_pod<uint32_t>(out, _refine);
+    write_pod<int32_t>(out, _rows);
+    write_pod<uint64_t>(out, _dsub);
+    write_vector(out, vector<int32_t>(_attributes.begin(), _attributes.end()));
+    _coarse.save(out);
+    write_pod<uint64_t>(out, _codebooks.size());
+    for (auto &&i : _codebooks)
+    {
+        i.save(out);
+    }
+    write_vector(out, _offsets);
+    write_vector(out, _ids);
+    write_vector(out, _codes);
+    return bool(out);
+}
+
+bool IVFPQIndex::load(istream &in, Dataset &dataset)
+{
+    char magic[sizeof(ivfpq_magic)] = {};
+    in.read(magic, sizeof(magic));
+    if (not equal(magic, magic + sizeof(magic), ivfpq_magic) or read_pod<uint32_t>(in) != ivfpq_version)
+        return false;
+
+    _nprobe = max(read_pod<uint32_t>(in), 1u);
+    _refine = read_pod<uint32_t>(in);
+    _rows = read_pod<int32_t>(in);
+    _dsub = read_pod<uint64_t>(in);
+    auto attributes = read_vector<int32_t>(in);
+    _attributes.assign(attributes.begin(), attributes.end());
+    _coarse.load(in);
+    uint64_t m = read_pod<uint64_t>(in);
+    if (not in or m == 0 or m > max<size_t>(_attributes.size(), 1) or _dsub == 0 or _dsub > max<size_t>(_attributes.size(), 1))
+        return false;
+    _codebooks.assign(m, KMeans(codebook_size));
+    for (auto &&i : _codebooks)
+    {
+        i.load(in);
+    }
+    _offsets = read_vector<uint64_t>(in);
+    _ids = read_vector<int32_t>(in);
+    _codes = read_vector<uint8_t>(in);
+    if (not in or _rows != dataset.no_rows() or not valid_attributes(dataset, _attributes))
+        return false;
+
+    // the lists and the codes are walked straight from these, so a corrupt file must not reach a search.
+    size_t dim = m * _dsub;
+    if (_attributes.size() > dim or _coarse.centroids().size() != _coarse.size() * dim)
+        return false;
+    for (auto &&i : _codebooks)
+    {
+        if (i.size() > codebook_size or i.centroids().size() != i.size() * _dsub)
+            return false;
+    }
+    if (_offsets.size() != _coarse.size() + 1 or _offsets.front() != 0 or _offsets.back() != (uint64_t)_rows or
+        not is_sorted(_offsets.begin(), _offsets.end()) or _ids.size() != (size_t)_rows or _codes.size() != _rows * m)
+        return false;
+    if (not all_of(_ids.begin(), _ids.end(), [this](int32_t i)
+                   { return i >= 0 and i < _rows; }))
+        return false;
+    for (size_t e = 0; e < _codes.size(); e++)
+    {
+        if (_codes[e] >= _codebooks[e % m].size())
+            return false;
+    }
+    return true;
+}
+
+void IVFPQIndex::set_nprobe(unsigned int nprobe)
+{
+    _nprobe = max(nprobe, 1u);
+}
+
+size_t IVFPQIndex::lists_size() const
+{
+    return _codes.size() + _ids.size() * sizeof(int32_t);
+}
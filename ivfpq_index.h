@@ -0,0 +1,101 @@
+#ifndef H_IVFPQ_INDEX
+#define H_IVFPQ_INDEX
+/**
+ * @file ivfpq_index.cpp
+ * @brief Implementation of an inverted-file index with product-quantized residuals (IVF-PQ).
+ *
+ * This file contains the implementation of the `IVFPQIndex` class. A k-means coarse quantizer splits the rows into
+ * inverted lists; each row is stored in its list as m one-byte codes, the nearest centroids of the m subvectors of
+ * its residual in per-subspace codebooks, both trained on a sample of the dataset. A query visits the nprobe
+ * nearest lists and scores their codes by asymmetric distance computation: one lookup table of subvector
+ * distances per list, then m table lookups per row.
+ *
+ * Saved file layout: magic "KNNIVFPQ", version, parameters, attribute positions, coarse quantizer, codebooks, and
+ * the lists as offsets, row ids and codes.
+ */
+
+#include "search_index.h"
+#include "kmeans.h"
+#include <cstdint>
+#include <atomic>
+
+/**
+ * @brief An IVF-PQ index over the normalized numeric features, ranked by Euclidean distance.
+ *
+ * A row costs m bytes of codes and 4 bytes of id. With `refine` set the best `refine * k` rows by estimated
+ * distance are reranked with the exact proximity measure, which also accounts for categorical attributes;
+ * with `refine` 0 the estimated Euclidean distances are returned as they are and the rows are never read.
+ */
+class IVFPQIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs an IVF-PQ index.
+     *
+     * @param lists The number of inverted lists, 0 for sqrt(rows) (default is 0).
+     * @param subspaces The number of subspaces m, 0 for one per two features (default is 0).
+     * @param nprobe The number of lists visited per query (default is 8).
+     * @param refine The number of candidates reranked exactly, as a multiple of k, 0 to skip (default is 4).
+     * @param train_sample The number of rows the quantizers are trained on (default is 65536).
+     */
+    IVFPQIndex(unsigned int lists = 0, unsigned int subspaces = 0, unsigned int nprobe = 8, unsigned int refine = 4, unsigned int train_sample = 1 << 16);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    /**
+     * @brief Find the k nearest neighbors of a target, visiting a given number of lists.
+     *
+     * Reached from `KNN::predict` and `KNN::first_knn` through their nprobe argument.
+     *
+     * @param nprobe The number of lists to visit for this query, 0 for the index's setting.
+     */
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int nprobe) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+    bool save(ostream &out) const override;
+
+    bool load(istream &in, Dataset &dataset) override;
+
+    /**
+     * @brief Set the number of lists visited by queries that do not give their own.
+     *
+     * Safe to call on the live index (`KNN::get_index`) while queries run; later queries use the new value.
+     *
+     * @param nprobe The number of lists.
+     */
+    void set_nprobe(unsigned int nprobe);
+
+    /**
+     * @brief Retrieves the number of bytes used by the codes and row ids.
+     *
+     * @return The size of the inverted lists.
+     */
+    size_t lists_size() const;
+
+private:
+    unsigned int _lists, _subspaces;     /**< The number of lists and of subspaces asked for. */
+    atomic<unsigned int> _nprobe;        /**< The lists visited by default, changed while queries run. */
+    unsigned int _refine, _train_sample; /**< The parameters. */
+    vector<int> _attributes;             /**< The positions of the numeric, non-label attributes. */
+    size_t _dsub = 0;                    /**< The dimension of a subspace; the features are zero padded to m * dsub. */
+    int _rows = 0;                       /**< The number of indexed rows. */
+    KMeans _coarse;                      /**< The coarse quantizer. */
+    vector<KMeans> _codebooks;           /**< The codebook of each subspace, over residuals. */
+    vector<uint64_t> _offsets;           /**< The first entry of each list, plus the end. */
+    vector<int32_t> _ids;                /**< The row of each entry, grouped by list. */
+    vector<uint8_t> _codes;              /**< The m codes of each entry, grouped by list. */
+
+    /**
+     * @brief The padded feature vector of a data point.
+     */
+    void features(const Dataset &dataset, const vector<Dataset::DataType> &data_point, float *out) const;
+};
+
+#endif
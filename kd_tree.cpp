@@ -0,0 +1,246 @@
+#include "kd_tree.h"
+#include "kmeans.h"
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+KDTree::KDTree(const float *data, size_t n, size_t dim, unsigned int leaf_size) : _dim{dim}, _ids(n)
+{
+    iota(_ids.begin(), _ids.end(), 0);
+    if (n)
+        build(data, 0, n, max(leaf_size, 1u));
+
+    _data.resize(n * dim);
+    for (size_t i = 0; i < n; i++)
+    {
+        copy(data + _ids[i] * dim, data + (_ids[i] + 1) * dim, _data.begin() + i * dim);
+    }
+}
+
+int32_t KDTree::build(const float *data, uint32_t begin, uint32_t end, unsigned int leaf_size)
+{
+    int32_t node = _nodes.size();
+    _nodes.push_back(Node{begin, end, -1, -1});
+    _low.insert(_low.end(), _dim, numeric_limits<float>::max());
+    _high.insert(_high.end(), _dim, numeric_limits<float>::lowest());
+    float *low = _low.data() + node * _dim, *high = _high.data() + node * _dim;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        for (size_t j = 0; j < _dim; j++)
+        {
+            low[j] = min(low[j], data[_ids[i] * _dim + j]);
+            high[j] = max(high[j], data[_ids[i] * _dim + j]);
+        }
+    }
+
+    size_t widest = 0;
+    for (size_t j = 1; j < _dim; j++)
+    {
+        if (high[j] - low[j] > high[widest] - low[widest])
+            widest = j;
+    }
+    if (end - begin <= leaf_size or _dim == 0 or high[widest] <= low[widest])
+        return node;
+
+    uint32_t middle = begin + (end - begin) / 2;
+    nth_element(_ids.begin() + begin, _ids.begin() + middle, _ids.begin() + end, [&](uint32_t a, uint32_t b)
+                { return data[a * _dim + widest] < data[b * _dim + widest]; });
+    int32_t left = build(data, begin, middle, leaf_size);
+    int32_t right = build(data, middle, end, leaf_size);
+    _nodes[node].left = left;
+    _nodes[node].right = right;
+    return node;
+}
+
+float KDTree::box_distance(int32_t node, const KDTree &other, int32_t other_node) const
+{
+    const float *low = _low.data() + node * _dim, *high = _high.data() + node * _dim;
+    const float *other_low = other._low.data() + other_node * _dim, *other_high = other._high.data() + other_node * _dim;
+    float sum = 0;
+    for (size_t j = 0; j < _dim; j++)
+    {
+        float gap = max(max(other_low[j] - high[j], low[j] - other_high[j]), 0.0f);
+        sum += gap * gap;
+    }
+    return sum;
+}
+
+float KDTree::point_distance(int32_t node, const float *x) const
+{
+    const float *low = _low.data() + node * _dim, *high = _high.data() + node * _dim;
+    float sum = 0;
+    for (size_t j = 0; j < _dim; j++)
+    {
+        float gap = max(max(low[j] - x[j], x[j] - high[j]), 0.0f);
+        sum += gap * gap;
+    }
+    return sum;
+}
+
+vector<vector<pair<float, int>>> KDTree::knn(const KDTree &queries, unsigned int k, unsigned int threads) const
+{
+    size_t n = queries.size();
+    vector<vector<pair<float, int>>> heaps(n); // a max-heap per reordered query.
+    k = min<size_t>(k, size());
+    if (n == 0 or k == 0)
+        return heaps;
+
+    // the largest k-th best distance over a query node's queries: no farther reference node can improve any of them.
+    vector<float> bounds(queries._nodes.size(), numeric_limits<float>::max());
+    auto kth = [&](uint32_t query)
+    {
+        return heaps[query].size() < k ? numeric_limits<float>::max() : heaps[query].front().first;
+    };
+
+    auto scan = [&](uint32_t query, int32_t node)
+    {
+        const float *x = queries._data.data() + query * _dim;
+        auto &heap = heaps[query];
+        for (uint32_t j = _nodes[node].begin; j < _nodes[node].end; j++)
+        {
+            float distance = squared_l2(x, _data.data() + j * _dim, _dim);
+            if (heap.size() < k)
+            {
+                heap.push_back(make_pair(distance, (int)_ids[j]));
+                push_heap(heap.begin(), heap.end());
+            }
+            else if (distance < heap.front().first)
+            {
+                pop_heap(heap.begin(), heap.end());
+                heap.back() = make_pair(distance, (int)_ids[j]);
+                push_heap(heap.begin(), heap.end());
+            }
+        }
+    };
+
+    // every query first scans the leaf it falls in, so that the bounds are tight from the first node pair on.
+    vector<int32_t> first_leaf(n, -1);
+    function<void(int32_t)> seed = [&](int32_t query_node)
+    {
+        const Node &q = queries._nodes[query_node];
+        if (q.left >= 0)
+        {
+            seed(q.left);
+            seed(q.right);
+            bounds[query_node] = max(bounds[q.left], bounds[q.right]);
+            return;
+        }
+        float bound = 0;
+        for (uint32_t i = q.begin; i < q.end; i++)
+        {
+            const float *x = queries._data.data() + i * _dim;
+            int32_t node = 0;
+            while (_nodes[node].left >= 0)
+            {
+                int32_t left = _nodes[node].left, right = _nodes[node].right;
+                node = point_distance(right, x) < point_distance(left, x) ? right : left;
+            }
+            first_leaf[i] = node;
+            scan(i, node);
+            bound = max(bound, kth(i));
+        }
+        bounds[query_node] = bound;
+    };
+
+    function<void(int32_t, int32_t)> traverse = [&](int32_t query_node, int32_t node)
+    {
+        if (box_distance(node, queries, query_node) > bounds[query_node])
+            return;
+        const Node &q = queries._nodes[query_node], &r = _nodes[node];
+        bool query_leaf = q.left < 0, leaf = r.left < 0;
+
+        if (query_leaf and leaf)
+        {
+            float bound = 0;
+            for (uint32_t i = q.begin; i < q.end; i++)
+            {
+                if (node != first_leaf[i] and point_distance(node, queries._data.data() + i * _dim) <= kth(i))
+                    scan(i, node);
+                bound = max(bound, kth(i));
+            }
+            bounds[query_node] = bound;
+        }
+        else if (query_leaf)
+        {
+            // the nearer child first, so that the bound is already tight for the farther one.
+            int32_t near = r.left, far = r.right;
+            if (box_distance(far, queries, query_node) < box_distance(near, queries, query_node))
+                swap(near, far);
+            traverse(query_node, near);
+            traverse(query_node, far);
+        }
+        else
+        {
+            // both trees are descended together; a child's queries are a subset of the node's, so its bound holds for them.
+            for (auto &&child : {q.left, q.right})
+            {
+                bounds[child] = min(bounds[child], bounds[query_node]);
+                if (leaf)
+                {
+                    traverse(child, node);
+                    continue;
+                }
+                int32_t near = r.left, far = r.right;
+                if (box_distance(far, queries, child) < box_distance(near, queries, child))
+                    swap(near, far);
+                traverse(child, near);
+                traverse(child, far);
+            }
+            bounds[query_node] = max(bounds[q.left], bounds[q.right]);
+        }
+    };
+
+    // disjoint query subtrees share no heaps or bounds, so they are searched on separate threads.
+    threads = threads ? threads : max(thread::hardware_concurrency(), 1u);
+    vector<int32_t> tasks{0};
+    while (tasks.size() < 8 * threads)
+    {
+        vector<int32_t> next;
+        for (auto &&i : tasks)
+        {
+            if (queries._nodes[i].left < 0)
+                next.push_back(i);
+            else
+            {
+                next.push_back(queries._nodes[i].left);
+                next.push_back(queries._nodes[i].right);
+            }
+        }
+        if (next.size() == tasks.size())
+            break;
+        tasks = move(next);
+    }
+
+    atomic<size_t> next_task{0};
+    vector<thread> workers;
+    for (unsigned int t = 0; t < min<size_t>(threads, tasks.size()); t++)
+    {
+        workers.emplace_back([&]()
+                             {
+            for (size_t task = next_task++; task < tasks.size(); task = next_task++)
+            {
+                seed(tasks[task]);
+                traverse(tasks[task], 0);
+            } });
+    }
+    for (auto &&i : workers)
+    {
+        i.join();
+    }
+
+    vector<vector<pair<float, int>>> res(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sort_heap(heaps[i].begin(), heaps[i].end());
+        res[queries._ids[i]] = move(heaps[i]);
+    }
+    return res;
+}
+
+size_t KDTree::size() const
+{
+    return _ids.size();
+}
@@ -0,0 +1,89 @@
+#ifndef H_KD_TREE
+#define H_KD_TREE
+/**
+ * @file kd_tree.cpp
+ * @brief Implementation of a kd-tree over float vectors with a dual-tree all-k-nearest-neighbors search.
+ *
+ * This file contains the implementation of the `KDTree` class. A tree splits its vectors at the median of the
+ * widest dimension of their bounding box until a leaf holds at most `leaf_size` vectors, and keeps the vectors
+ * reordered so that every node is a contiguous run. A batch of queries is answered by building a second tree over
+ * the queries and descending both trees together: a pair of nodes is pruned as soon as the distance between their
+ * boxes exceeds the k-th best distance of every query in the query node, so whole groups of queries skip a subtree
+ * at once instead of each rediscovering it.
+ */
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+using namespace std;
+
+/**
+ * @brief A kd-tree over dense float vectors, searched with the squared Euclidean distance.
+ */
+class KDTree
+{
+public:
+    /**
+     * @brief Build a tree over a set of vectors.
+     *
+     * @param data The vectors, row-major.
+     * @param n The number of vectors.
+     * @param dim The dimension of the vectors.
+     * @param leaf_size The maximum number of vectors in a leaf (default is 16).
+     */
+    KDTree(const float *data, size_t n, size_t dim, unsigned int leaf_size = 16);
+
+    /**
+     * @brief Find the k nearest vectors of the tree for every vector of a query tree, in one dual traversal.
+     *
+     * Subtrees of the query tree are searched in parallel.
+     *
+     * @param queries The tree over the query vectors, of the same dimension.
+     * @param k The number of nearest neighbors.
+     * @param threads The number of threads, 0 for the hardware concurrency (default is 0).
+     * @return For each query, in the order the queries were given: pairs of squared distance and vector index, nearest first.
+     */
+    vector<vector<pair<float, int>>> knn(const KDTree &queries, unsigned int k, unsigned int threads = 0) const;
+
+    /**
+     * @brief Retrieves the number of vectors in the tree.
+     */
+    size_t size() const;
+
+private:
+    /**
+     * @brief A node: a contiguous run of vectors and its bounding box.
+     */
+    struct Node
+    {
+        uint32_t begin, end; /**< The run of reordered vectors. */
+        int32_t left, right; /**< The children, -1 for a leaf. */
+    };
+
+    size_t _dim;
+    vector<float> _data;     /**< The vectors, reordered so that every node is contiguous. */
+    vector<uint32_t> _ids;   /**< The original index of every reordered vector. */
+    vector<Node> _nodes;     /**< The nodes, the root first. */
+    vector<float> _low;      /**< The lower corner of every node's box. */
+    vector<float> _high;     /**< The upper corner of every node's box. */
+
+    /**
+     * @brief Build the subtree over a run of `_ids` and return its node.
+     *
+     * @param data The vectors, in their original order.
+     */
+    int32_t build(const float *data, uint32_t begin, uint32_t end, unsigned int leaf_size);
+
+    /**
+     * @brief The squared distance between the boxes of a node of this tree and a node of another.
+     */
+    float box_distance(int32_t node, const KDTree &other, int32_t other_node) const;
+
+    /**
+     * @brief The squared distance between the box of a node and a vector.
+     */
+    float point_distance(int32_t node, const float *x) const;
+};
+
+#endif
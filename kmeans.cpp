@@ -0,0 +1,194 @@
+#include "kmeans.h"
+#include "binary_io.h"
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+float squared_l2(const float *a, const float *b, size_t dim)
+{
+    float sum = 0;
+    for (size_t i = 0; i < dim; i++)
+    {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+KMeans::KMeans(size_t k, unsigned int iterations, unsigned int seed, unsigned int threads)
+    : _k{max<size_t>(k, 1)}, _iterations{iterations}, _seed{seed}, _threads{threads ? threads : max(thread::hardware_concurrency(), 1u)}
+{
+}
+
+void KMeans::fit(const float *data, size_t n, size_t dim)
+{
+    // beyond a few hundred vectors per centroid a larger sample barely moves the centroids.
+    const size_t max_points = 256 * _k;
+    vector<float> sample;
+    if (n > max_points)
+    {
+        mt19937 generator(_seed);
+        sample.resize(max_points * dim);
+        for (size_t i = 0; i < max_points; i++)
+        {
+            size_t at = uniform_int_distribution<size_t>(0, n - 1)(generator);
+            copy(data + at * dim, data + (at + 1) * dim, sample.begin() + i * dim);
+        }
+        data = sample.data();
+        n = max_points;
+    }
+
+    _dim = dim;
+    _k = min(_k, max<size_t>(n, 1));
+    _centroids.assign(_k * dim, 0);
+    if (n == 0)
+        return;
+
+    mt19937 generator(_seed);
+    vector<size_t> order(n);
+    iota(order.begin(), order.end(), 0);
+    for (size_t i = 0; i < _k; i++)
+    {
+        swap(order[i], order[uniform_int_distribution<size_t>(i, n - 1)(generator)]);
+        copy(data + order[i] * dim, data + (order[i] + 1) * dim, _centroids.begin() + i * dim);
+    }
+
+    vector<uint32_t> assignment(n, numeric_limits<uint32_t>::max());
+    for (unsigned int iteration = 0; iteration < _iterations; iteration++)
+    {
+        // each thread assigns a slice of the vectors and accumulates its own sums.
+        unsigned int threads = min<size_t>(_threads, (n + 1023) / 1024);
+        vector<vector<double>> sums(threads, vector<double>(_k * dim, 0));
+        vector<vector<size_t>> counts(threads, vector<size_t>(_k, 0));
+        vector<size_t> changed(threads, 0);
+        vector<thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t]()
+                                 {
+                for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++)
+                {
+                    uint32_t c = nearest(data + i * dim);
+                    changed[t] += c != assignment[i];
+                    assignment[i] = c;
+                    counts[t][c]++;
+                    for (size_t j = 0; j < dim; j++)
+                    {
+                        sums[t][c * dim + j] += data[i * dim + j];
+                    }
+                } });
+        }
+        for (auto &&i : workers)
+        {
+            i.join();
+        }
+
+        for (unsigned int t = 1; t < threads; t++)
+        {
+            for (size_t i = 0; i < _k * dim; i++)
+            {
+                sums[0][i] += sums[t][i];
+            }
+            for (size_t i = 0; i < _k; i++)
+            {
+                counts[0][i] += counts[t][i];
+            }
+            changed[0] += changed[t];
+        }
+
+        for (size_t c = 0; c < _k; c++)
+        {
+            if (counts[0][c] == 0)
+            {
+                size_t i = uniform_int_distribution<size_t>(0, n - 1)(generator);
+                copy(data + i * dim, data + (i + 1) * dim, _centroids.begin() + c * dim);
+                continue;
+            }
+            for (size_t j = 0; j < dim; j++)
+            {
+                _centroids[c * dim + j] = sums[0][c * dim + j] / counts[0][c];
+            }
+        }
+
+        if (changed[0] == 0)
+            break;
+    }
+}
+
+uint32_t KMeans::nearest(const float *x) const
+{
+    uint32_t best = 0;
+    float best_distance = numeric_limits<float>::max();
+    for (size_t c = 0; c < _k; c++)
+    {
+        float distance = squared_l2(x, _centroids.data() + c * _dim, _dim);
+        if (distance < best_distance)
+        {
+            best_distance = distance;
+            best = c;
+        }
+    }
+    return best;
+}
+
+vector<uint32_t> KMeans::assign(const float *data, size_t n) const
+{
+    vector<uint32_t> assignment(n);
+    unsigned int threads = max<size_t>(min<size_t>(_threads, (n + 1023) / 1024), 1);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++)
+            {
+                assignment[i] = nearest(data + i * _dim);
+            } });
+    }
+    for (auto &&i : workers)
+    {
+        i.join();
+    }
+    return assignment;
+}
+
+vector<float> KMeans::distances(const float *x) const
+{
+    vector<float> res(_k);
+    for (size_t c = 0; c < _k; c++)
+    {
+        res[c] = squared_l2(x, _centroids.data() + c * _dim, _dim);
+    }
+    return res;
+}
+
+const vector<float> &KMeans::centroids() const
+{
+    return _centroids;
+}
+
+size_t KMeans::size() const
+{
+    return _k;
+}
+
+void KMeans::save(ostream &out) const
+{
+    write_pod<uint64_t>(out, _k);
+    write_pod<uint64_t>(out, _dim);
+    write_vector(out, _centroids);
+}
+
+void KMeans::load(istream &in)
+{
+    _k = read_pod<uint64_t>(in);
+    _dim = read_pod<uint64_t>(in);
+    _centroids = read_vector<float>(in);
+    bool shaped = _dim ? _centroids.size() % _dim == 0 and _centroids.size() / _dim == _k : _centroids.empty();
+    if (_k == 0 or not shaped)
+    {
+        in.setstate(ios::failbit);
+    }
+}
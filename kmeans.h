@@ -0,0 +1,106 @@
+#ifndef H_KMEANS
+#define H_KMEANS
+/**
+ * @file kmeans.cpp
+ * @brief Implementation of a multithreaded k-means clustering of float vectors.
+ *
+ * This file contains the implementation of the `KMeans` class, used by the clustered search indexes to train
+ * coarse quantizers and codebooks. Vectors are stored row-major as floats; the assignment step, which dominates
+ * the cost, is split across threads, and the update step merges per-thread partial sums.
+ */
+
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief Lloyd's k-means over dense float vectors.
+ */
+class KMeans
+{
+public:
+    /**
+     * @brief Constructs an untrained k-means model.
+     *
+     * @param k The number of centroids.
+     * @param iterations The maximum number of Lloyd iterations (default is 20).
+     * @param seed The seed used to pick the initial centroids (default is 0).
+     * @param threads The number of threads, 0 for the hardware concurrency (default is 0).
+     */
+    KMeans(size_t k, unsigned int iterations = 20, unsigned int seed = 0, unsigned int threads = 0);
+
+    /**
+     * @brief Cluster a set of vectors.
+     *
+     * The centroids start at distinct random vectors; a centroid left empty is moved onto a random vector.
+     * When there are fewer vectors than centroids, k is reduced to the number of vectors; when there are more
+     * than 256 per centroid, a random sample of that size is clustered.
+     *
+     * @param data The vectors, row-major.
+     * @param n The number of vectors.
+     * @param dim The dimension of the vectors.
+     */
+    void fit(const float *data, size_t n, size_t dim);
+
+    /**
+     * @brief Find the centroid nearest to a vector.
+     *
+     * @param x The vector.
+     * @return The index of the nearest centroid.
+     */
+    uint32_t nearest(const float *x) const;
+
+    /**
+     * @brief Find the nearest centroid of every vector, in parallel.
+     *
+     * @param data The vectors, row-major.
+     * @param n The number of vectors.
+     * @return The index of the nearest centroid of each vector.
+     */
+    vector<uint32_t> assign(const float *data, size_t n) const;
+
+    /**
+     * @brief Retrieves the squared Euclidean distance between a vector and every centroid.
+     *
+     * @param x The vector.
+     * @return The squared distance to each centroid.
+     */
+    vector<float> distances(const float *x) const;
+
+    /**
+     * @brief Retrieves the centroids, row-major.
+     */
+    const vector<float> &centroids() const;
+
+    /**
+     * @brief Retrieves the number of centroids.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Write the trained centroids to a binary stream.
+     */
+    void save(ostream &out) const;
+
+    /**
+     * @brief Read centroids written by `save`.
+     */
+    void load(istream &in);
+
+private:
+    size_t _k;                 /**< The number of centroids. */
+    unsigned int _iterations;  /**< The maximum number of Lloyd iterations. */
+    unsigned int _seed;        /**< The seed of the initialization. */
+    unsigned int _threads;     /**< The number of threads. */
+    size_t _dim = 0;           /**< The dimension of the vectors. */
+    vector<float> _centroids;  /**< The centroids, row-major. */
+};
+
+/**
+ * @brief The squared Euclidean distance between two float vectors.
+ */
+float squared_l2(const float *a, const float *b, size_t dim);
+
+#endif
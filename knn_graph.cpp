@@ -0,0 +1,299 @@
+#include "knn_graph.h"
+#include "KNN.h"
+#include "kmeans.h"
+#include <functional>
+#include <random>
+#include <thread>
+
+PackedFeatures::PackedFeatures(Dataset &dataset)
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    vector<int> numeric, categorical;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == dataset.get_label())
+            continue;
+        if (find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            numeric.push_back(i);
+        else
+            categorical.push_back(i);
+    }
+
+    size_t rows = dataset.no_rows();
+    _dim = numeric.size();
+    _categories = categorical.size();
+    _features.resize(rows * _dim);
+    _codes.resize(rows * _categories);
+    for (size_t j = 0; j < _dim; j++)
+    {
+        auto &values = dataset[keys[numeric[j]]];
+        for (size_t i = 0; i < rows; i++)
+        {
+            _features[i * _dim + j] = get<double>(values[i]);
+        }
+    }
+    for (size_t j = 0; j < _categories; j++)
+    {
+        unordered_map<string, int32_t> dictionary;
+        auto &values = dataset[keys[categorical[j]]];
+        for (size_t i = 0; i < rows; i++)
+        {
+            _codes[i * _categories + j] = dictionary.insert(make_pair(get<string>(values[i]), (int32_t)dictionary.size())).first->second;
+        }
+    }
+}
+
+float PackedFeatures::distance(int a, int b) const
+{
+    float sum = squared_l2(features(a), features(b), _dim);
+    for (size_t j = 0; j < _categories; j++)
+    {
+        sum += _codes[a * _categories + j] == _codes[b * _categories + j];
+    }
+    return sum;
+}
+
+const float *PackedFeatures::features(int row) const
+{
+    return _features.data() + row * _dim;
+}
+
+size_t PackedFeatures::dim() const
+{
+    return _dim;
+}
+
+KNNGraph::KNNGraph(unsigned int k, unsigned int iterations, double sample, double delta, unsigned int threads, unsigned int seed)
+    : _k{max(k, 1u)}, _max_iterations{iterations}, _threads{threads ? threads : max(thread::hardware_concurrency(), 1u)}, _seed{seed},
+      _sample{min(max(sample, 0.0), 1.0)}, _delta{max(delta, 0.0)}
+{
+}
+
+void KNNGraph::build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    _rows = dataset.no_rows();
+    _iterations = 0;
+    _graph.clear();
+    if (_rows < 2)
+        return;
+    unsigned int k = min<unsigned int>(_k, _rows - 1);
+
+    // the Euclidean measure is evaluated on packed features.
+    _packed = proximity_measure == euclidean_distance_mesure;
+    PackedFeatures packed;
+    vector<vector<Dataset::DataType>> rows;
+    if (_packed)
+        packed = PackedFeatures(dataset);
+    else
+    {
+        for (int i = 0; i < _rows; i++)
+        {
+            rows.push_back(dataset.iterrow(i));
+        }
+    }
+
+    function<float(int, int)> distance;
+    if (_packed)
+        distance = [&](int a, int b)
+        { return packed.distance(a, b); };
+    else
+        distance = [&](int a, int b)
+        { return (float)proximity_measure(&dataset, rows[a], rows[b]); };
+
+    // rows are locked by stripes while their heaps are updated from the joins of other rows.
+    vector<mutex> locks(4096);
+    auto update = [&](int row, int neighbor, float d)
+    {
+        lock_guard<mutex> lock(locks[row % locks.size()]);
+        Neighbor *heap = _graph.data() + (size_t)row * k;
+        if (d >= heap[0].distance)
+            return false;
+        for (unsigned int j = 0; j < k; j++)
+        {
+            if (heap[j].row == neighbor)
+                return false;
+        }
+        pop_heap(heap, heap + k, [](const Neighbor &a, const Neighbor &b)
+                 { return a.distance < b.distance; });
+        heap[k - 1] = Neighbor{d, neighbor, true};
+        push_heap(heap, heap + k, [](const Neighbor &a, const Neighbor &b)
+                  { return a.distance < b.distance; });
+        return true;
+    };
+
+    auto parallel = [&](const function<void(int, int, unsigned int)> &work)
+    {
+        unsigned int threads = max<size_t>(min<size_t>(_threads, (_rows + 1023) / 1024), 1);
+        vector<thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            workers.emplace_back(work, (int)((size_t)_rows * t / threads), (int)((size_t)_rows * (t + 1) / threads), t);
+        }
+        for (auto &&i : workers)
+        {
+            i.join();
+        }
+    };
+
+    // every row starts with k distinct random neighbors.
+    _graph.resize((size_t)_rows * k);
+    parallel([&](int begin, int end, unsigned int t)
+             {
+        mt19937 generator(_seed + t);
+        uniform_int_distribution<int> pick(0, _rows - 2);
+        for (int i = begin; i < end; i++)
+        {
+            Neighbor *heap = _graph.data() + (size_t)i * k;
+            for (unsigned int j = 0; j < k; j++)
+            {
+                int neighbor;
+                do
+                {
+                    neighbor = pick(generator);
+                    neighbor += neighbor >= i;
+                } while (any_of(heap, heap + j, [&](const Neighbor &n)
+                                { return n.row == neighbor; }));
+                heap[j] = Neighbor{distance(i, neighbor), neighbor, true};
+            }
+            make_heap(heap, heap + k, [](const Neighbor &a, const Neighbor &b)
+                      { return a.distance < b.distance; });
+        } });
+
+    mt19937 generator(_seed);
+    size_t samples = max<size_t>(_sample * k, 1);
+    vector<vector<int>> fresh(_rows), old(_rows), reverse_fresh(_rows), reverse_old(_rows);
+    for (; _iterations < _max_iterations; _iterations++)
+    {
+        // a sample of the fresh neighbors joins this iteration and is marked old; old ones only meet fresh ones.
+        for (int i = 0; i < _rows; i++)
+        {
+            fresh[i].clear();
+            old[i].clear();
+            Neighbor *heap = _graph.data() + (size_t)i * k;
+            vector<unsigned int> unseen;
+            for (unsigned int j = 0; j < k; j++)
+            {
+                if (heap[j].fresh)
+                    unseen.push_back(j);
+                else
+                    old[i].push_back(heap[j].row);
+            }
+            shuffle(unseen.begin(), unseen.end(), generator);
+            unseen.resize(min(unseen.size(), samples));
+            for (auto &&j : unseen)
+            {
+                heap[j].fresh = false;
+                fresh[i].push_back(heap[j].row);
+            }
+        }
+
+        for (int i = 0; i < _rows; i++)
+        {
+            reverse_fresh[i].clear();
+            reverse_old[i].clear();
+        }
+        for (int i = 0; i < _rows; i++)
+        {
+            for (auto &&j : fresh[i])
+            {
+                reverse_fresh[j].push_back(i);
+            }
+            for (auto &&j : old[i])
+            {
+                reverse_old[j].push_back(i);
+            }
+        }
+        for (int i = 0; i < _rows; i++)
+        {
+            for (auto *lists : {&reverse_fresh, &reverse_old})
+            {
+                auto &reverse = (*lists)[i];
+                shuffle(reverse.begin(), reverse.end(), generator);
+                reverse.resize(min(reverse.size(), samples));
+            }
+            fresh[i].insert(fresh[i].end(), reverse_fresh[i].begin(), reverse_fresh[i].end());
+            old[i].insert(old[i].end(), reverse_old[i].begin(), reverse_old[i].end());
+            for (auto *list : {&fresh[i], &old[i]})
+            {
+                sort(list->begin(), list->end());
+                list->erase(unique(list->begin(), list->end()), list->end());
+            }
+        }
+
+        // local join: every pair of fresh rows, and every fresh row with every old one, around each row.
+        vector<size_t> updates(_threads, 0);
+        parallel([&](int begin, int end, unsigned int t)
+                 {
+            for (int i = begin; i < end; i++)
+            {
+                auto &f = fresh[i], &o = old[i];
+                for (size_t a = 0; a < f.size(); a++)
+                {
+                    for (size_t b = a + 1; b < f.size(); b++)
+                    {
+                        float d = distance(f[a], f[b]);
+                        updates[t] += update(f[a], f[b], d) + update(f[b], f[a], d);
+                    }
+                    for (auto &&b : o)
+                    {
+                        if (b == f[a])
+                            continue;
+                        float d = distance(f[a], b);
+                        updates[t] += update(f[a], b, d) + update(b, f[a], d);
+                    }
+                }
+            } });
+
+        if (accumulate(updates.begin(), updates.end(), (size_t)0) <= _delta * _rows * k)
+        {
+            _iterations++;
+            break;
+        }
+    }
+}
+
+vector<pair<double, int>> KNNGraph::neighbors(int row) const
+{
+    if (row < 0 or row >= _rows or _graph.empty())
+        throw range_error("index out of range.\n");
+
+    size_t k = _graph.size() / _rows;
+    vector<pair<double, int>> res;
+    for (size_t j = 0; j < k; j++)
+    {
+        auto &neighbor = _graph[row * k + j];
+        res.push_back(make_pair(_packed ? sqrt(max(neighbor.distance, 0.0f)) : neighbor.distance, neighbor.row));
+    }
+    sort(res.begin(), res.end());
+    return res;
+}
+
+vector<double> KNNGraph::outlier_scores() const
+{
+    vector<double> scores(_rows, 0);
+    for (int i = 0; i < _rows and not _graph.empty(); i++)
+    {
+        auto neighbors = this->neighbors(i);
+        for (auto &&j : neighbors)
+        {
+            scores[i] += j.first / neighbors.size();
+        }
+    }
+    return scores;
+}
+
+int KNNGraph::no_rows() const
+{
+    return _rows;
+}
+
+unsigned int KNNGraph::get_k() const
+{
+    return _rows > 1 ? _graph.size() / _rows : _k;
+}
+
+unsigned int KNNGraph::get_iterations() const
+{
+    return _iterations;
+}
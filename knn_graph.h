@@ -0,0 +1,133 @@
+#ifndef H_KNN_GRAPH
+#define H_KNN_GRAPH
+/**
+ * @file knn_graph.cpp
+ * @brief Implementation of an approximate k-nearest neighbor graph of a whole dataset built with NN-Descent.
+ *
+ * This file contains the implementation of the `KNNGraph` class. NN-Descent starts every row with k random
+ * neighbors and repeatedly refines them by local joins: the neighbors and reverse neighbors of a row are compared
+ * with one another, on the premise that a neighbor of a neighbor is likely a neighbor. Only a sample of the rows
+ * added since the previous iteration takes part in each join, and the joins run in parallel. The cost grows roughly
+ * as n^1.14 instead of the n^2 of one scan per row.
+ */
+
+#include "dataset.h"
+#include <cstdint>
+
+/**
+ * @brief The rows of a dataset packed for the Euclidean measure: numeric values as floats, categoricals as codes.
+ */
+class PackedFeatures
+{
+public:
+    PackedFeatures() = default;
+
+    /**
+     * @brief Pack the non-label attributes of every row of a (normalized) dataset.
+     */
+    PackedFeatures(Dataset &dataset);
+
+    /**
+     * @brief The Euclidean measure between two rows, squared.
+     */
+    float distance(int a, int b) const;
+
+    /**
+     * @brief Retrieves the numeric features of a row.
+     */
+    const float *features(int row) const;
+
+    /**
+     * @brief Retrieves the number of numeric features of a row.
+     */
+    size_t dim() const;
+
+private:
+    size_t _dim = 0, _categories = 0;
+    vector<float> _features; /**< The numeric values, row-major. */
+    vector<int32_t> _codes;  /**< The categorical values as per-attribute codes, row-major. */
+};
+
+/**
+ * @brief The approximate k nearest neighbors of every row of a dataset, the row itself excluded.
+ *
+ * Paired with `euclidean_distance_mesure` the distances are computed on packed copies of the features; any other
+ * measure is called on the rows directly. The measure must be a distance: smaller is nearer.
+ */
+class KNNGraph
+{
+public:
+    /**
+     * @brief Constructs an empty graph.
+     *
+     * @param k The number of neighbors of every row.
+     * @param iterations The maximum number of NN-Descent iterations (default is 12).
+     * @param sample The fraction of k new neighbors and reverse neighbors joined per row and iteration (default is 0.5).
+     * @param delta Iterations stop once fewer than delta * n * k neighbors changed (default is 0.001).
+     * @param threads The number of threads, 0 for the hardware concurrency (default is 0).
+     * @param seed The seed of the random initial neighbors and of the sampling (default is 0).
+     */
+    KNNGraph(unsigned int k, unsigned int iterations = 12, double sample = 0.5, double delta = 0.001, unsigned int threads = 0, unsigned int seed = 0);
+
+    /**
+     * @brief Build the graph over a (normalized) dataset.
+     *
+     * k is reduced to the number of rows minus one.
+     *
+     * @param dataset The dataset.
+     * @param proximity_measure The distance between rows.
+     */
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &));
+
+    /**
+     * @brief Retrieves the neighbors of a row.
+     *
+     * @param row The row index.
+     * @return Vector of pairs: distance and row index of the neighbors, nearest first.
+     *
+     * @note If the row is out of range, a range_error is thrown.
+     */
+    vector<pair<double, int>> neighbors(int row) const;
+
+    /**
+     * @brief Score every row by its mean distance to its k neighbors; the largest scores are the outliers.
+     *
+     * @return The score of each row.
+     */
+    vector<double> outlier_scores() const;
+
+    /**
+     * @brief Retrieves the number of rows in the graph.
+     */
+    int no_rows() const;
+
+    /**
+     * @brief Retrieves the number of neighbors of every row.
+     */
+    unsigned int get_k() const;
+
+    /**
+     * @brief Retrieves the number of NN-Descent iterations the last build ran.
+     */
+    unsigned int get_iterations() const;
+
+private:
+    /**
+     * @brief An entry of a row's neighbor heap.
+     */
+    struct Neighbor
+    {
+        float distance; /**< The distance, squared on the packed path. */
+        int32_t row;    /**< The neighbor. */
+        bool fresh;     /**< Whether the neighbor has not yet taken part in a local join. */
+    };
+
+    unsigned int _k, _max_iterations, _threads, _seed;
+    double _sample, _delta;
+    unsigned int _iterations = 0; /**< The iterations run by the last build. */
+    int _rows = 0;                /**< The number of rows. */
+    bool _packed = false;         /**< Whether distances were computed on packed features, and squared. */
+    vector<Neighbor> _graph;      /**< A max-heap of k neighbors per row, by distance. */
+};
+
+#endif
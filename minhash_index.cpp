@@ -0,0 +1,122 @@
+#include "minhash_index.h"
+#include "string_similarity.h"
+
+namespace
+{
+    uint64_t mix(uint64_t x)
+    {
+        // splitmix64 finalizer
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+}
+
+MinHashIndex::MinHashIndex(const string &attribute, unsigned int bands, unsigned int rows, unsigned int shingle)
+    : _attribute{attribute}, _bands{bands}, _rows{rows}, _shingle{shingle}
+{
+    if (bands == 0 or rows == 0 or shingle == 0)
+    {
+        throw range_error("bands, rows and shingle should be > 0.\n");
+    }
+}
+
+vector<uint64_t> MinHashIndex::signature(const string &str) const
+{
+    u32string codepoints = decode_utf8(str);
+
+    vector<uint64_t> shingles;
+    for (size_t i = 0; i + _shingle <= codepoints.size() or (i == 0 and not codepoints.empty()); i++)
+    {
+        uint64_t h = 0;
+        for (size_t j = i; j < min<size_t>(i + _shingle, codepoints.size()); j++)
+        {
+            h = mix(h + codepoints[j]);
+        }
+        shingles.push_back(h);
+    }
+
+    // number repeated shingles by occurrence, so the set semantics of MinHash match multisets.
+    sort(shingles.begin(), shingles.end());
+    uint64_t previous = 0;
+    for (size_t i = 0, occurrence = 0; i < shingles.size(); i++)
+    {
+        uint64_t shingle = shingles[i];
+        occurrence = (i > 0 and shingle == previous) ? occurrence + 1 : 0;
+        previous = shingle;
+        shingles[i] = mix(shingle ^ mix(occurrence));
+    }
+
+    vector<uint64_t> res(_bands * _rows, UINT64_MAX);
+    for (auto &&x : shingles)
+    {
+        for (size_t i = 0; i < res.size(); i++)
+        {
+            res[i] = min(res[i], mix(x ^ mix(i + 1)));
+        }
+    }
+    return res;
+}
+
+void MinHashIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    _column = string_column(dataset, _attribute);
+
+    _buckets.assign(_bands, {});
+    auto &values = dataset[keys[_column]];
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        auto minhashes = signature(get<string>(values[i]));
+        for (size_t band = 0; band < _bands; band++)
+        {
+            uint64_t key = 0;
+            for (size_t j = band * _rows; j < (band + 1) * _rows; j++)
+            {
+                key = mix(key ^ minhashes[j]);
+            }
+            _buckets[band][key].push_back(i);
+        }
+    }
+}
+
+vector<pair<double, int>> MinHashIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    auto minhashes = signature(get<string>(target[column(dataset, target, _column)]));
+    vector<int> candidates;
+
+    for (size_t band = 0; band < _bands; band++)
+    {
+        uint64_t key = 0;
+        for (size_t j = band * _rows; j < (band + 1) * _rows; j++)
+        {
+            key = mix(key ^ minhashes[j]);
+        }
+
+        auto bucket = _buckets[band].find(key);
+        if (bucket != _buckets[band].end())
+            candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+    }
+
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    if (candidates.size() < k)
+    {
+        candidates.resize(dataset.no_rows());
+        iota(candidates.begin(), candidates.end(), 0);
+    }
+
+    return rerank(dataset, target, candidates, k, proximity_measure);
+}
+
+shared_ptr<SearchIndex> MinHashIndex::clone() const
+{
+    return make_shared<MinHashIndex>(_attribute, _bands, _rows, _shingle);
+}
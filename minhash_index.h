@@ -0,0 +1,68 @@
+#ifndef H_MINHASH_INDEX
+#define H_MINHASH_INDEX
+/**
+ * @file minhash_index.cpp
+ * @brief Implementation of a MinHash / locality-sensitive hashing search backend for string attributes.
+ *
+ * This file contains the implementation of the `MinHashIndex` class. Every value of a string attribute is turned
+ * into a set of character shingles and summarized by a MinHash signature; the signature is cut into bands and each
+ * band is hashed into a bucket. A query only scores the rows sharing at least one bucket with it, then reranks them
+ * with the exact proximity measure.
+ */
+
+#include "search_index.h"
+#include <cstdint>
+
+/**
+ * @brief A banded MinHash LSH index over a string attribute.
+ *
+ * Repeated shingles are numbered by occurrence, so the set Jaccard similarity estimated by MinHash is the
+ * multiset Jaccard similarity of the shingles. Two values with Jaccard similarity s collide in at least one band
+ * with probability 1 - (1 - s^rows)^bands: more bands raise the recall, more rows per band make buckets
+ * smaller and more selective.
+ */
+class MinHashIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs a MinHash index.
+     *
+     * @param attribute The string attribute to index, empty for the first categorical attribute that is not the label.
+     * @param bands The number of bands (default is 16).
+     * @param rows The number of MinHash values per band (default is 2).
+     * @param shingle The number of characters per shingle (default is 1, matching the character Jaccard measures).
+     */
+    MinHashIndex(const string &attribute = "", unsigned int bands = 16, unsigned int rows = 2, unsigned int shingle = 1);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    /**
+     * @brief Find the k nearest neighbors of a target among the rows sharing a bucket with it.
+     *
+     * Candidates are reranked with the proximity measure. When fewer than k rows collide with the target,
+     * every row is scored instead.
+     */
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+    /**
+     * @brief Compute the MinHash signature of a string.
+     *
+     * @param str The UTF-8 encoded string.
+     * @return bands * rows MinHash values.
+     */
+    vector<uint64_t> signature(const string &str) const;
+
+private:
+    string _attribute;                                      /**< The name of the indexed attribute. */
+    unsigned int _bands;                                    /**< The number of bands. */
+    unsigned int _rows;                                     /**< The number of MinHash values per band. */
+    unsigned int _shingle;                                  /**< The number of characters per shingle. */
+    int _column = 0;                                        /**< The position of the indexed attribute. */
+    vector<unordered_map<uint64_t, vector<int>>> _buckets;  /**< Per band, the rows of every bucket. */
+};
+
+#endif
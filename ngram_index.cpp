@@ -0,0 +1,150 @@
+#include "ngram_index.h"
+#include "string_similarity.h"
+#include <cmath>
+
+NGramIndex::NGramIndex(const string &attribute, const vector<unsigned int> &grams, double min_shared, unsigned int max_candidates)
+    : _attribute{attribute}, _grams{grams}, _min_shared{min_shared}, _max_candidates{max_candidates}
+{
+    if (grams.empty() or find(grams.begin(), grams.end(), 0u) != grams.end())
+    {
+        throw range_error("n-gram lengths should be > 0.\n");
+    }
+}
+
+vector<uint64_t> NGramIndex::ngrams(const string &str) const
+{
+    vector<uint64_t> res;
+
+    for (auto &&n : _grams)
+    {
+        // pad with n - 1 boundary markers on both sides, so prefixes and suffixes make their own n-grams.
+        u32string padded = u32string(n - 1, U'\2') + decode_utf8(str) + u32string(n - 1, U'\3');
+
+        for (size_t i = 0; i + n <= padded.size(); i++)
+        {
+            uint64_t key = n;
+            for (size_t j = i; j < i + n; j++)
+            {
+                key = key * 0x100000001b3ull ^ padded[j];
+            }
+            res.push_back(key);
+        }
+    }
+
+    sort(res.begin(), res.end());
+    res.erase(unique(res.begin(), res.end()), res.end());
+    return res;
+}
+
+void NGramIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    _column = string_column(dataset, _attribute);
+
+    _index.clear();
+    _rows = dataset.no_rows();
+    auto &values = dataset[keys[_column]];
+
+    for (int i = 0; i < _rows; i++)
+    {
+        for (auto &&gram : ngrams(get<string>(values[i])))
+        {
+            auto &posting = _index[gram];
+            // rows are appended in increasing order, so only the gap is stored, 7 bits per byte.
+            uint32_t gap = i - posting.last;
+            posting.last = i;
+            for (; gap >= 0x80; gap >>= 7)
+            {
+                posting.bytes.push_back((gap & 0x7f) | 0x80);
+            }
+            posting.bytes.push_back(gap);
+        }
+    }
+
+    for (auto &&i : _index)
+    {
+        i.second.bytes.shrink_to_fit();
+    }
+}
+
+vector<pair<double, int>> NGramIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    auto grams = ngrams(get<string>(target[column(dataset, target, _column)]));
+
+    // per-thread counters, reset through the list of touched rows rather than cleared.
+    thread_local vector<uint16_t> counts;
+    thread_local vector<int> touched;
+    if (counts.size() < (size_t)_rows)
+        counts.resize(_rows);
+    touched.clear();
+
+    for (auto &&gram : grams)
+    {
+        auto posting = _index.find(gram);
+        if (posting == _index.end())
+            continue;
+
+        int row = -1;
+        auto &bytes = posting->second.bytes;
+        for (size_t i = 0; i < bytes.size();)
+        {
+            uint32_t gap = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                gap |= (bytes[i] & 0x7f) << shift;
+                if (not(bytes[i++] & 0x80))
+                    break;
+            }
+            row += gap;
+            if (counts[row]++ == 0)
+                touched.push_back(row);
+        }
+    }
+
+    unsigned int threshold = max<unsigned int>(1, ceil(_min_shared * grams.size()));
+    vector<pair<int, int>> passed; // (-shared, row), most shared first
+    for (auto &&row : touched)
+    {
+        if (counts[row] >= threshold)
+            passed.push_back(make_pair(-counts[row], row));
+        counts[row] = 0;
+    }
+
+    size_t limit = _max_candidates ? _max_candidates : 32 * k;
+    if (passed.size() > limit)
+    {
+        nth_element(passed.begin(), passed.begin() + limit, passed.end());
+        passed.resize(limit);
+    }
+
+    vector<int> candidates;
+    for (auto &&i : passed)
+    {
+        candidates.push_back(i.second);
+    }
+
+    if (candidates.size() < k)
+    {
+        candidates.resize(dataset.no_rows());
+        iota(candidates.begin(), candidates.end(), 0);
+    }
+
+    return rerank(dataset, target, candidates, k, proximity_measure);
+}
+
+shared_ptr<SearchIndex> NGramIndex::clone() const
+{
+    return make_shared<NGramIndex>(_attribute, _grams, _min_shared, _max_candidates);
+}
+
+size_t NGramIndex::postings_size() const
+{
+    size_t size = 0;
+    for (auto &&i : _index)
+    {
+        size += i.second.bytes.size();
+    }
+    return size;
+}
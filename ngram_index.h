@@ -0,0 +1,80 @@
+#ifndef H_NGRAM_INDEX
+#define H_NGRAM_INDEX
+/**
+ * @file ngram_index.cpp
+ * @brief Implementation of a character n-gram inverted index for candidate generation on string attributes.
+ *
+ * This file contains the implementation of the `NGramIndex` class. Every value of a string attribute is split
+ * into padded character n-grams, and each n-gram keeps a posting list of the rows containing it, delta and
+ * varint encoded. A query counts, per row, the n-grams it shares with the target by walking its posting lists,
+ * keeps the rows passing the count filter and reranks them with the exact proximity measure.
+ */
+
+#include "search_index.h"
+#include <cstdint>
+
+/**
+ * @brief An inverted index from character n-grams to the rows containing them.
+ *
+ * Similar strings share many n-grams (an edit changes at most n of them), so the rows sharing the most n-grams
+ * with the target are the likely neighbors, for any string measure.
+ */
+class NGramIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs an n-gram index.
+     *
+     * @param attribute The string attribute to index, empty for the first categorical attribute that is not the label.
+     * @param grams The n-gram lengths to index (default is 2 and 3).
+     * @param min_shared The fraction of the target's n-grams a row must share to be a candidate (default is 0.3).
+     * @param max_candidates The maximum number of candidates reranked per query, those sharing the most n-grams
+     * (default is 0, for 32 * k).
+     */
+    NGramIndex(const string &attribute = "", const vector<unsigned int> &grams = {2, 3}, double min_shared = 0.3, unsigned int max_candidates = 0);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    /**
+     * @brief Find the k nearest neighbors of a target among the rows passing the count filter.
+     *
+     * When fewer than k rows pass, every row is scored instead.
+     */
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+    /**
+     * @brief Retrieves the number of bytes used by the posting lists.
+     *
+     * @return The size of the compressed posting lists.
+     */
+    size_t postings_size() const;
+
+private:
+    /**
+     * @brief The rows containing an n-gram, as varint-encoded gaps between increasing row indices.
+     */
+    struct Posting
+    {
+        vector<uint8_t> bytes; /**< The encoded gaps. */
+        int last = -1;         /**< The last row appended. */
+    };
+
+    string _attribute;                        /**< The name of the indexed attribute. */
+    vector<unsigned int> _grams;              /**< The n-gram lengths. */
+    double _min_shared;                       /**< The count filter, as a fraction of the target's n-grams. */
+    unsigned int _max_candidates;             /**< The maximum number of candidates, 0 for 32 * k. */
+    int _column = 0;                          /**< The position of the indexed attribute. */
+    int _rows = 0;                            /**< The number of indexed rows. */
+    unordered_map<uint64_t, Posting> _index;  /**< The posting list of every n-gram. */
+
+    /**
+     * @brief The distinct n-gram keys of a string.
+     */
+    vector<uint64_t> ngrams(const string &str) const;
+};
+
+#endif
@@ -0,0 +1,406 @@
+#include "out_of_core_knn.h"
+#include "binary_io.h"
+
+namespace
+{
+    const char magic[8] = {'K', 'N', 'N', 'B', 'L', 'K', 0, 0};
+    const unsigned int version = 1;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t dims;
+        uint64_t rows;
+        uint64_t trailer;
+    };
+
+    struct Trailer
+    {
+        vector<string> keys;
+        uint32_t label_index = 0;
+        vector<uint32_t> columns;
+        vector<double> min, max;
+        vector<Dataset::DataType> labels;
+    };
+
+    void write_trailer(ostream &out, const Trailer &trailer)
+    {
+        write_pod<uint32_t>(out, trailer.keys.size());
+        for (auto &&i : trailer.keys)
+            write_string(out, i);
+
+        write_pod<uint32_t>(out, trailer.label_index);
+        write_pod<uint32_t>(out, trailer.columns.size());
+        for (size_t i = 0; i < trailer.columns.size(); i++)
+        {
+            write_pod<uint32_t>(out, trailer.columns[i]);
+            write_pod<double>(out, trailer.min[i]);
+            write_pod<double>(out, trailer.max[i]);
+        }
+
+        write_pod<uint32_t>(out, trailer.labels.size());
+        for (auto &&i : trailer.labels)
+        {
+            write_pod<uint8_t>(out, holds_alternative<string>(i));
+            if (holds_alternative<double>(i))
+                write_pod<double>(out, get<double>(i));
+            else
+                write_string(out, get<string>(i));
+        }
+    }
+
+    Trailer read_trailer(istream &in)
+    {
+        // the counts come from the file, so the entries are appended while the stream holds rather than allocated up front.
+        Trailer trailer;
+        for (uint32_t i = 0, n = read_pod<uint32_t>(in); i < n and in; i++)
+            trailer.keys.push_back(read_string(in));
+
+        trailer.label_index = read_pod<uint32_t>(in);
+        for (uint32_t i = 0, n = read_pod<uint32_t>(in); i < n and in; i++)
+        {
+            trailer.columns.push_back(read_pod<uint32_t>(in));
+            trailer.min.push_back(read_pod<double>(in));
+            trailer.max.push_back(read_pod<double>(in));
+        }
+
+        for (uint32_t i = 0, n = read_pod<uint32_t>(in); i < n and in; i++)
+        {
+            if (read_pod<uint8_t>(in))
+                trailer.labels.push_back(read_string(in));
+            else
+                trailer.labels.push_back(read_pod<double>(in));
+        }
+        return trailer;
+    }
+
+    /**
+     * @brief Check that a trailer read from `in` agrees with its header, throwing if it does not.
+     */
+    void check_trailer(const istream &in, const Header &header, const Trailer &trailer, const string &path)
+    {
+        size_t record = header.dims * sizeof(float) + sizeof(uint32_t);
+        bool valid = in and header.dims == trailer.columns.size() and trailer.label_index < trailer.keys.size() and
+                     header.trailer >= sizeof(Header) and (header.trailer - sizeof(Header)) / record == header.rows;
+        for (auto &&i : trailer.columns)
+        {
+            valid = valid and i < trailer.keys.size() and i != trailer.label_index;
+        }
+        if (not valid)
+        {
+            throw runtime_error(path + " : the block file is truncated or corrupt.\n");
+        }
+    }
+
+    Header read_header(istream &in, const string &path)
+    {
+        Header header = read_pod<Header>(in);
+        if (not in or not equal(magic, magic + 8, header.magic) or header.version != version)
+        {
+            throw runtime_error(path + " : not a block file.\n");
+        }
+        return header;
+    }
+}
+
+OutOfCoreKNN::OutOfCoreKNN(const string &path, int k, unsigned int block_rows, unsigned int batch_size)
+    : _path{path}, _k{(unsigned int)k}, _block_rows{block_rows}, _batch_size{batch_size}
+{
+    if (k <= 0 or block_rows == 0 or batch_size == 0)
+    {
+        throw invalid_argument("k, the block rows and the batch size should be > 0.\n");
+    }
+
+    ifstream in(path, ios::binary);
+    if (not in.is_open())
+    {
+        throw runtime_error(path + " : No such file or the path is incorrect\n");
+    }
+
+    Header header = read_header(in, path);
+    in.seekg(header.trailer);
+    Trailer trailer = read_trailer(in);
+    check_trailer(in, header, trailer, path);
+
+    _rows = header.rows;
+    keys = trailer.keys;
+    _label_index = trailer.label_index;
+    _columns.assign(trailer.columns.begin(), trailer.columns.end());
+    _min = trailer.min;
+    _max = trailer.max;
+    _labels = trailer.labels;
+}
+
+void OutOfCoreKNN::write_blocks(const Dataset &dataset, const string &path, bool append)
+{
+    auto attributes = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    string label = dataset.get_label();
+
+    Header header{};
+    Trailer trailer;
+    fstream out;
+
+    if (append)
+    {
+        out.open(path, ios::binary | ios::in | ios::out);
+        if (not out.is_open())
+        {
+            throw runtime_error(path + " : No such file or the path is incorrect\n");
+        }
+        header = read_header(out, path);
+        out.seekg(header.trailer);
+        trailer = read_trailer(out);
+        check_trailer(out, header, trailer, path);
+        if (trailer.keys != attributes or trailer.keys[trailer.label_index] != label)
+        {
+            throw invalid_argument("the dataset attributes do not match " + path + "\n");
+        }
+    }
+    else
+    {
+        out.open(path, ios::binary | ios::in | ios::out | ios::trunc);
+        if (not out.is_open())
+        {
+            throw runtime_error(path + " : No such file or the path is incorrect\n");
+        }
+        copy(magic, magic + 8, header.magic);
+        header.version = version;
+        header.trailer = sizeof(Header);
+
+        trailer.keys = attributes;
+        for (size_t i = 0; i < attributes.size(); i++)
+        {
+            if (attributes[i] == label)
+            {
+                trailer.label_index = i;
+            }
+            else if (find(numerics.begin(), numerics.end(), attributes[i]) != numerics.end())
+            {
+                trailer.columns.push_back(i);
+                trailer.min.push_back(__DBL_MAX__);
+                trailer.max.push_back(-__DBL_MAX__);
+            }
+        }
+        header.dims = trailer.columns.size();
+    }
+
+    unordered_map<Dataset::DataType, uint32_t> codes;
+    for (size_t i = 0; i < trailer.labels.size(); i++)
+    {
+        codes[trailer.labels[i]] = i;
+    }
+
+    // the new rows overwrite the old trailer, which is written again after them.
+    out.seekp(header.trailer);
+    vector<float> record(header.dims);
+
+    for (int i = 0; i < dataset.no_rows(); i++)
+    {
+        auto row = dataset.iterrow(i);
+        for (size_t j = 0; j < header.dims; j++)
+        {
+            double value = get<double>(row[trailer.columns[j]]);
+            trailer.min[j] = min(trailer.min[j], value);
+            trailer.max[j] = max(trailer.max[j], value);
+            record[j] = value;
+        }
+
+        auto code = codes.find(row[trailer.label_index]);
+        if (code == codes.end())
+        {
+            code = codes.insert(make_pair(row[trailer.label_index], (uint32_t)trailer.labels.size())).first;
+            trailer.labels.push_back(row[trailer.label_index]);
+        }
+
+        out.write(reinterpret_cast<const char *>(record.data()), record.size() * sizeof(float));
+        write_pod<uint32_t>(out, code->second);
+    }
+
+    header.rows += dataset.no_rows();
+    header.trailer = out.tellp();
+    write_trailer(out, trailer);
+
+    out.seekp(0);
+    write_pod(out, header);
+    if (not out)
+    {
+        throw runtime_error(path + " : writing the block file failed.\n");
+    }
+}
+
+vector<float> OutOfCoreKNN::features(const vector<Dataset::DataType> &data_point) const
+{
+    // data points without the label value are shifted by one after the label position.
+    bool has_label = data_point.size() == keys.size();
+    vector<float> res;
+
+    for (auto &&i : _columns)
+    {
+        res.push_back(get<double>(data_point[(has_label or i < _label_index) ? i : i - 1]));
+    }
+    return res;
+}
+
+vector<vector<pair<double, Dataset::DataType>>> OutOfCoreKNN::first_knn(const vector<vector<Dataset::DataType>> &targets) const
+{
+    size_t dims = _columns.size(), record = dims * sizeof(float) + sizeof(uint32_t);
+
+    vector<vector<float>> queries;
+    for (auto &&i : targets)
+    {
+        queries.push_back(features(i));
+    }
+
+    // range normalization folded into per-feature weights, so the stored rows stay raw.
+    vector<float> weights(dims);
+    for (size_t j = 0; j < dims; j++)
+    {
+        weights[j] = (_max[j] > _min[j]) ? 1.0 / ((_max[j] - _min[j]) * (_max[j] - _min[j])) : 0.0;
+    }
+
+    vector<priority_queue<pair<float, uint32_t>>> heaps(targets.size());
+
+    ifstream in(_path, ios::binary);
+    if (not in.is_open())
+    {
+        throw runtime_error(_path + " : No such file or the path is incorrect\n");
+    }
+    vector<char> buffers[2];
+    buffers[0].resize((size_t)_block_rows * record);
+    buffers[1].resize((size_t)_block_rows * record);
+
+    auto read_block = [&](vector<char> *buffer, unsigned long long first)
+    {
+        size_t rows = min<unsigned long long>(_block_rows, _rows - first);
+        in.seekg(sizeof(Header) + first * record);
+        in.read(buffer->data(), rows * record);
+        if (not in)
+        {
+            throw runtime_error(_path + " : the block file is truncated.\n");
+        }
+        return rows;
+    };
+
+    int current = 0;
+    future<size_t> next = async(launch::async, read_block, &buffers[0], 0ull);
+
+    for (unsigned long long first = 0; first < _rows; first += _block_rows)
+    {
+        size_t rows = next.get();
+        // prefetch the next block while this one is scanned.
+        if (first + _block_rows < _rows)
+        {
+            next = async(launch::async, read_block, &buffers[current ^ 1], first + _block_rows);
+        }
+
+        const char *block = buffers[current].data();
+        for (size_t r = 0; r < rows; r++)
+        {
+            const float *row = reinterpret_cast<const float *>(block + r * record);
+            uint32_t label;
+            memcpy(&label, block + r * record + dims * sizeof(float), sizeof(uint32_t));
+            if (label >= _labels.size())
+            {
+                throw runtime_error(_path + " : the block file is corrupt, a label is out of range.\n");
+            }
+
+            for (size_t q = 0; q < queries.size(); q++)
+            {
+                const float *query = queries[q].data();
+                float distance = 0.0;
+                for (size_t j = 0; j < dims; j++)
+                {
+                    float diff = row[j] - query[j];
+                    distance += weights[j] * diff * diff;
+                }
+
+                auto &heap = heaps[q];
+                if (heap.size() < _k)
+                {
+                    heap.push(make_pair(distance, label));
+                }
+                else if (distance < heap.top().first)
+                {
+                    heap.pop();
+                    heap.push(make_pair(distance, label));
+                }
+            }
+        }
+        current ^= 1;
+    }
+
+    vector<vector<pair<double, Dataset::DataType>>> res(targets.size());
+    for (size_t q = 0; q < heaps.size(); q++)
+    {
+        for (; not heaps[q].empty(); heaps[q].pop())
+        {
+            res[q].push_back(make_pair(sqrt(heaps[q].top().first), _labels[heaps[q].top().second]));
+        }
+        reverse(res[q].begin(), res[q].end());
+    }
+    return res;
+}
+
+Dataset::DataType OutOfCoreKNN::predict(const vector<Dataset::DataType> &sample)
+{
+    return KNN::vote(first_knn({sample}).front());
+}
+
+unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> OutOfCoreKNN::evaluate(Dataset &testData)
+{
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> confusion_matrix;
+
+    for (int i = 0; i < testData.no_rows(); i += _batch_size)
+    {
+        vector<vector<Dataset::DataType>> batch;
+        for (int j = i; j < min<int>(i + _batch_size, testData.no_rows()); j++)
+        {
+            batch.push_back(testData.iterrow(j));
+        }
+
+        auto neighbours = first_knn(batch);
+        for (size_t j = 0; j < batch.size(); j++)
+        {
+            ++confusion_matrix[batch[j][_label_index]][KNN::vote(neighbours[j])];
+        }
+    }
+
+    report(confusion_matrix);
+
+    return confusion_matrix;
+}
+
+unsigned long long OutOfCoreKNN::no_rows() const
+{
+    return _rows;
+}
+
+unsigned int OutOfCoreKNN::get_k() const
+{
+    return _k;
+}
+
+void OutOfCoreKNN::set_k(unsigned int k)
+{
+    if (k == 0)
+    {
+        throw invalid_argument("k should be > 0.\n");
+    }
+    _k = k;
+}
+
+void OutOfCoreKNN::train(const Dataset &trainingData)
+{
+    write_blocks(trainingData, _path, true);
+    *this = OutOfCoreKNN(_path, _k, _block_rows, _batch_size);
+}
+
+void OutOfCoreKNN::saveModel(const string &)
+{
+}
+
+void OutOfCoreKNN::loadModel(const string &)
+{
+}
@@ -0,0 +1,128 @@
+#ifndef H_OUT_OF_CORE_KNN
+#define H_OUT_OF_CORE_KNN
+/**
+ * @file out_of_core_knn.cpp
+ * @brief Implementation of an out-of-core KNN classifier that streams its training set from disk.
+ *
+ * This file contains the implementation of the `OutOfCoreKNN` class, a KNN classifier whose training rows are
+ * kept in a binary block file instead of memory. A query batch is answered with one sequential pass over the
+ * file: each block is scanned against every query of the batch while the next block is read in the background,
+ * and per-query top-k heaps are updated as the pass goes.
+ *
+ * Block file layout (little-endian, native types):
+ *  - header: magic "KNNBLK", version, number of features, number of rows, trailer offset;
+ *  - rows: the raw numeric features as float32 followed by a uint32 label code, one record per row;
+ *  - trailer: attribute names, label position, feature columns with their bounds, and the label dictionary.
+ */
+
+#include "KNN.h"
+#include <future>
+#include <queue>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief A KNN classifier over a training set stored in a binary block file.
+ *
+ * Distances are Euclidean over the numeric attributes, range-normalized with the bounds of the whole file;
+ * categorical attributes other than the label are not stored.
+ */
+class OutOfCoreKNN : public Classifier
+{
+public:
+    /**
+     * @brief Constructs an out-of-core KNN classifier over a block file.
+     *
+     * @param path The path to a block file written by `write_blocks`.
+     * @param k The number of nearest neighbors to consider (default is 1).
+     * @param block_rows The number of rows read from disk at a time (default is 65536).
+     * @param batch_size The number of queries answered by one pass over the file in `evaluate` (default is 1024).
+     * @throw invalid_argument If k, the block rows or the batch size is 0.
+     * @throw runtime_error If the file cannot be opened or is not a well-formed block file.
+     */
+    OutOfCoreKNN(const string &path, int k = 1, unsigned int block_rows = 1 << 16, unsigned int batch_size = 1024);
+
+    /**
+     * @brief Write the rows of a dataset to a block file.
+     *
+     * The dataset must have its label set and must not be normalized; the bounds are computed from the stored rows.
+     * Appending lets a file larger than memory be built from several datasets read one at a time.
+     *
+     * @param dataset The (unnormalized) dataset to write.
+     * @param path The path to the block file.
+     * @param append Whether to append to an existing block file with the same attributes (default is false).
+     */
+    static void write_blocks(const Dataset &dataset, const string &path, bool append = false);
+
+    /**
+     * @brief Perform k-nearest neighbor search for a batch of targets with a single pass over the file.
+     *
+     * @param targets The target data points, with or without the label value.
+     * @return For each target, pairs of distance and label of its nearest neighbors, nearest first.
+     */
+    vector<vector<pair<double, Dataset::DataType>>> first_knn(const vector<vector<Dataset::DataType>> &targets) const;
+
+    /**
+     * @brief Predicts the class label for a given sample.
+     *
+     * @param sample The input sample for which to predict the class label.
+     * @return The predicted class label.
+     */
+    Dataset::DataType predict(const vector<Dataset::DataType> &sample) override;
+
+    /**
+     * @brief Evaluate the classifier's performance on a test dataset, return the confusion matrix,
+     * and print a classification report including micro-accuracy, micro-recall, and micro-precision.
+     *
+     * Test rows are answered in batches, one pass over the file per batch.
+     *
+     * @param testData The dataset used for evaluation.
+     * @return A confusion matrix containing counts of actual and predicted labels for each class.
+     */
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> evaluate(Dataset &testData) override;
+
+    /**
+     * @brief Retrieves the number of rows in the block file.
+     *
+     * @return The number of rows.
+     */
+    unsigned long long no_rows() const;
+
+    /**
+     * @brief Get the value of k.
+     *
+     * @return The value of k.
+     */
+    unsigned int get_k() const;
+
+    /**
+     * @brief Set the value of k.
+     *
+     * @param k The new value to set for k.
+     */
+    void set_k(unsigned int k);
+
+private:
+    string _path;                       /**< The path to the block file. */
+    unsigned int _k;                    /**< The number of nearest neighbors to consider. */
+    unsigned int _block_rows;           /**< The number of rows per block. */
+    unsigned int _batch_size;           /**< The number of queries per pass in `evaluate`. */
+    unsigned long long _rows;           /**< The number of rows in the file. */
+    vector<string> keys;                /**< The attribute names, label included. */
+    int _label_index;                   /**< The position of the label attribute. */
+    vector<int> _columns;               /**< The position of each stored feature among the attributes. */
+    vector<double> _min;                /**< The lower bound of each feature. */
+    vector<double> _max;                /**< The upper bound of each feature. */
+    vector<Dataset::DataType> _labels;  /**< The label dictionary, indexed by label code. */
+
+    /**
+     * @brief Extract the raw features of a data point, with or without the label value.
+     */
+    vector<float> features(const vector<Dataset::DataType> &data_point) const;
+
+    void train(const Dataset &trainingData) override;
+    void saveModel(const std::string &filePath) override;
+    void loadModel(const std::string &filePath) override;
+};
+
+#endif
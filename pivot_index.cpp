@@ -0,0 +1,160 @@
+#include "pivot_index.h"
+#include "binary_io.h"
+#include <queue>
+#include <limits>
+
+namespace
+{
+    const char pivot_magic[8] = {'K', 'N', 'N', 'P', 'I', 'V', 'O', 'T'};
+    const uint32_t pivot_version = 1;
+}
+
+PivotIndex::PivotIndex(unsigned int pivots) : _pivot_count{max(pivots, 1u)} {}
+
+void PivotIndex::build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    _rows = dataset.no_rows();
+    _pivots.clear();
+    _table.clear();
+
+    vector<vector<Dataset::DataType>> rows;
+    for (int i = 0; i < _rows; i++)
+    {
+        rows.push_back(dataset.iterrow(i));
+    }
+
+    // every pivot is the row farthest from the pivots before it; its column of the table is computed on the way.
+    vector<vector<float>> columns;
+    vector<double> nearest_pivot(_rows, numeric_limits<double>::max());
+    for (int next = 0; _rows and _pivots.size() < _pivot_count and nearest_pivot[next] > 0;)
+    {
+        _pivots.push_back(next);
+        columns.emplace_back(_rows);
+        int farthest = next;
+        for (int i = 0; i < _rows; i++)
+        {
+            double distance = proximity_measure(&dataset, rows[i], rows[_pivots.back()]);
+            columns.back()[i] = distance;
+            nearest_pivot[i] = min(nearest_pivot[i], distance);
+            if (nearest_pivot[i] > nearest_pivot[farthest])
+                farthest = i;
+        }
+        next = farthest;
+    }
+
+    size_t pivots = _pivots.size();
+    _table.resize(_rows * pivots);
+    for (size_t p = 0; p < pivots; p++)
+    {
+        for (int i = 0; i < _rows; i++)
+        {
+            _table[i * pivots + p] = columns[p][i];
+        }
+    }
+}
+
+vector<pair<double, int>> PivotIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    size_t pivots = _pivots.size();
+    k = min<unsigned int>(k, _rows);
+    if (k == 0)
+        return {};
+
+    priority_queue<pair<double, int>> best; // a max-heap of the k nearest rows so far.
+    auto offer = [&](double distance, int row)
+    {
+        if (best.size() < k)
+            best.push(make_pair(distance, row));
+        else if (distance < best.top().first)
+        {
+            best.pop();
+            best.push(make_pair(distance, row));
+        }
+    };
+
+    vector<double> to_pivots(pivots);
+    for (size_t p = 0; p < pivots; p++)
+    {
+        to_pivots[p] = proximity_measure(&dataset, dataset.iterrow(_pivots[p]), target);
+        offer(to_pivots[p], _pivots[p]);
+    }
+
+    // rows are visited by increasing lower bound, so the first one above the k-th best ends the search.
+    vector<pair<float, int>> bounds;
+    bounds.reserve(_rows);
+    for (int i = 0; i < _rows; i++)
+    {
+        float bound = 0;
+        for (size_t p = 0; p < pivots; p++)
+        {
+            bound = max<float>(bound, abs(to_pivots[p] - _table[i * pivots + p]));
+        }
+        bounds.push_back(make_pair(bound, i));
+    }
+    sort(bounds.begin(), bounds.end());
+
+    vector<bool> pivot(_rows, false);
+    for (auto &&p : _pivots)
+    {
+        pivot[p] = true;
+    }
+    // the table is stored in floats, the bound is loosened by their rounding.
+    const float slack = 1 + 1e-6f;
+    for (auto &&i : bounds)
+    {
+        if (best.size() == k and i.first > best.top().first * slack)
+            break;
+        if (not pivot[i.second])
+            offer(proximity_measure(&dataset, dataset.iterrow(i.second), target), i.second);
+    }
+
+    vector<pair<double, int>> res;
+    for (; not best.empty(); best.pop())
+    {
+        res.push_back(best.top());
+    }
+    reverse(res.begin(), res.end());
+    return res;
+}
+
+shared_ptr<SearchIndex> PivotIndex::clone() const
+{
+    return make_shared<PivotIndex>(_pivot_count);
+}
+
+bool PivotIndex::exact() const
+{
+    return true;
+}
+
+bool PivotIndex::save(ostream &out) const
+{
+    out.write(pivot_magic, sizeof(pivot_magic));
+    write_pod<uint32_t>(out, pivot_version);
+    write_pod<int32_t>(out, _rows);
+    write_vector(out, _pivots);
+    write_vector(out, _table);
+    return bool(out);
+}
+
+bool PivotIndex::load(istream &in, Dataset &dataset)
+{
+    char magic[sizeof(pivot_magic)] = {};
+    in.read(magic, sizeof(magic));
+    if (not equal(magic, magic + sizeof(magic), pivot_magic) or read_pod<uint32_t>(in) != pivot_version)
+        return false;
+
+    _rows = read_pod<int32_t>(in);
+    _pivots = read_vector<int32_t>(in);
+    _table = read_vector<float>(in);
+    return bool(in) and _rows == dataset.no_rows() and _table.size() == _pivots.size() * _rows and
+           all_of(_pivots.begin(), _pivots.end(), [this](int32_t i)
+                  { return i >= 0 and i < _rows; });
+}
+
+const vector<int32_t> &PivotIndex::get_pivots() const
+{
+    return _pivots;
+}
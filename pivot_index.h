@@ -0,0 +1,61 @@
+#ifndef H_PIVOT_INDEX
+#define H_PIVOT_INDEX
+/**
+ * @file pivot_index.cpp
+ * @brief Implementation of a pivot-table (LAESA) search index for arbitrary metrics.
+ *
+ * This file contains the implementation of the `PivotIndex` class. A few training rows are chosen as pivots, each
+ * as far as possible from the ones before it, and the distance of every row to every pivot is stored in a table.
+ * By the triangle inequality, |d(q, p) - d(x, p)| is a lower bound of d(q, x) for every pivot p, so a query only
+ * evaluates the proximity measure on the pivots and on the rows whose bound does not exceed its current k-th best
+ * distance. No tree is involved: any metric works, and the savings grow with the cost of the measure.
+ *
+ * Saved file layout: magic "KNNPIVOT", version, number of rows, pivot rows, and the distance table.
+ */
+
+#include "search_index.h"
+#include <cstdint>
+
+/**
+ * @brief A LAESA pivot table over a user-supplied proximity measure.
+ *
+ * The index is exact when the proximity measure is a metric (Jaccard, Levenshtein, Euclidean over numeric
+ * attributes, ...); with a measure that breaks the triangle inequality a neighbor can occasionally be missed.
+ */
+class PivotIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs a pivot index.
+     *
+     * @param pivots The number of pivots (default is 16).
+     */
+    PivotIndex(unsigned int pivots = 16);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+    bool exact() const override;
+
+    bool save(ostream &out) const override;
+
+    bool load(istream &in, Dataset &dataset) override;
+
+    /**
+     * @brief Retrieves the rows chosen as pivots.
+     */
+    const vector<int32_t> &get_pivots() const;
+
+private:
+    unsigned int _pivot_count; /**< The requested number of pivots. */
+    int _rows = 0;             /**< The number of indexed rows. */
+    vector<int32_t> _pivots;   /**< The pivot rows. */
+    vector<float> _table;      /**< The distance of every row to every pivot, row-major. */
+};
+
+#endif
@@ -0,0 +1,347 @@
+#include "prototype_selection.h"
+#include "knn_graph.h"
+#include "KNN.h"
+#include "kmeans.h"
+#include <limits>
+#include <queue>
+#include <thread>
+
+namespace
+{
+    /**
+     * @brief The rows of a dataset, their labels as class numbers, and the distance between two of them.
+     */
+    class Rows
+    {
+    public:
+        vector<int> labels;                   /**< The class of every row, the most frequent one of its copies. */
+        vector<vector<pair<int, int>>> copies; /**< The classes of the copies of every row, with their counts. */
+        int classes = 0;                      /**< The number of classes. */
+
+        Rows(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &),
+             const vector<LabelCounts> *multiplicities)
+            : _dataset{&dataset}, _proximity_measure{proximity_measure}, _packed{proximity_measure == euclidean_distance_mesure}
+        {
+            unordered_map<Dataset::DataType, int> classes;
+            auto &values = dataset[dataset.get_label()];
+            for (int i = 0; i < dataset.no_rows(); i++)
+            {
+                copies.emplace_back();
+                if (multiplicities and not(*multiplicities)[i].empty())
+                {
+                    for (auto &&j : (*multiplicities)[i])
+                    {
+                        copies.back().push_back(make_pair(classes.insert(make_pair(j.first, (int)classes.size())).first->second, j.second));
+                    }
+                }
+                else
+                    copies.back().push_back(make_pair(classes.insert(make_pair(values[i], (int)classes.size())).first->second, 1));
+                labels.push_back(max_element(copies.back().begin(), copies.back().end(), [](const pair<int, int> &a, const pair<int, int> &b)
+                                             { return a.second < b.second; })
+                                     ->first);
+            }
+            this->classes = classes.size();
+
+            // the Euclidean measure is evaluated on packed features.
+            if (_packed)
+                _packed_features = PackedFeatures(dataset);
+            else
+            {
+                for (int i = 0; i < dataset.no_rows(); i++)
+                {
+                    _rows.push_back(dataset.iterrow(i));
+                }
+            }
+        }
+
+        /**
+         * @brief The distance between two rows, squared on packed features.
+         */
+        float operator()(int a, int b) const
+        {
+            if (not _packed)
+                return _proximity_measure(_dataset, _rows[a], _rows[b]);
+
+            return _packed_features.distance(a, b);
+        }
+
+        /**
+         * @brief The row of every class nearest to the mean of its numeric features, or its first row.
+         */
+        vector<int> centers() const
+        {
+            vector<int> res(classes, -1);
+            size_t dim = _packed_features.dim();
+            if (not _packed or dim == 0)
+            {
+                for (int i = labels.size() - 1; i >= 0; i--)
+                {
+                    res[labels[i]] = i;
+                }
+                return res;
+            }
+
+            // every copy counts towards the mean.
+            vector<float> means(classes * dim, 0);
+            vector<size_t> counts(classes, 0);
+            for (size_t i = 0; i < labels.size(); i++)
+            {
+                int weight = 0;
+                for (auto &&j : copies[i])
+                {
+                    weight += j.second;
+                }
+                counts[labels[i]] += weight;
+                const float *features = _packed_features.features(i);
+                for (size_t j = 0; j < dim; j++)
+                {
+                    means[labels[i] * dim + j] += weight * features[j];
+                }
+            }
+            for (size_t i = 0; i < means.size(); i++)
+            {
+                means[i] /= counts[i / dim];
+            }
+            vector<float> best(classes, numeric_limits<float>::max());
+            for (size_t i = 0; i < labels.size(); i++)
+            {
+                float distance = squared_l2(_packed_features.features(i), means.data() + labels[i] * dim, dim);
+                if (distance < best[labels[i]])
+                {
+                    best[labels[i]] = distance;
+                    res[labels[i]] = i;
+                }
+            }
+            return res;
+        }
+
+        int size() const
+        {
+            return labels.size();
+        }
+
+    private:
+        Dataset *_dataset;
+        double (*_proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &);
+        bool _packed;
+        PackedFeatures _packed_features;
+        vector<vector<Dataset::DataType>> _rows;
+    };
+
+    /**
+     * @brief Run work(begin, end) over slices of [0, n) on separate threads.
+     */
+    template <typename Work>
+    void parallel(size_t n, unsigned int threads, Work work)
+    {
+        threads = threads ? threads : max(thread::hardware_concurrency(), 1u);
+        threads = max<size_t>(min<size_t>(threads, (n + 255) / 256), 1);
+        vector<thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            workers.emplace_back(work, n * t / threads, n * (t + 1) / threads);
+        }
+        for (auto &&i : workers)
+        {
+            i.join();
+        }
+    }
+
+    /**
+     * @brief Whether the class of a row holds a majority, ties included, among the first k votes of its other
+     * copies and of its neighbors, nearest first. Every row votes once per copy.
+     */
+    bool majority(const Rows &rows, int row, const vector<int> &neighbors, unsigned int k)
+    {
+        vector<int> votes(rows.classes, 0);
+        unsigned int cast = 0;
+        auto vote = [&](int at, bool self)
+        {
+            for (auto &&i : rows.copies[at])
+            {
+                // the row itself is one of its copies, of its own class.
+                for (int count = i.second - (self and i.first == rows.labels[row]); count > 0 and cast < k; count--, cast++)
+                {
+                    votes[i.first]++;
+                }
+            }
+        };
+        vote(row, true);
+        for (auto &&i : neighbors)
+        {
+            vote(i, false);
+        }
+        return votes[rows.labels[row]] == *max_element(votes.begin(), votes.end());
+    }
+
+    vector<int> kept_rows(const vector<char> &kept)
+    {
+        vector<int> res;
+        for (size_t i = 0; i < kept.size(); i++)
+        {
+            if (kept[i])
+                res.push_back(i);
+        }
+        return res;
+    }
+}
+
+vector<int> condensed_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &),
+    const vector<LabelCounts> *multiplicities)
+{
+    Rows rows(dataset, proximity_measure, multiplicities);
+    vector<char> kept(rows.size(), false);
+    vector<int> prototypes;
+    vector<char> seen(rows.classes, false);
+    for (int i = 0; i < rows.size(); i++)
+    {
+        if (not seen[rows.labels[i]])
+        {
+            seen[rows.labels[i]] = true;
+            kept[i] = true;
+            prototypes.push_back(i);
+        }
+    }
+
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (int i = 0; i < rows.size(); i++)
+        {
+            if (kept[i])
+                continue;
+            int nearest = prototypes.front();
+            float best = numeric_limits<float>::max();
+            for (auto &&j : prototypes)
+            {
+                float distance = rows(i, j);
+                if (distance < best)
+                {
+                    best = distance;
+                    nearest = j;
+                }
+            }
+            if (rows.labels[nearest] != rows.labels[i])
+            {
+                kept[i] = true;
+                prototypes.push_back(i);
+                changed = true;
+            }
+        }
+    }
+    return kept_rows(kept);
+}
+
+vector<int> fast_condensed_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int threads,
+    const vector<LabelCounts> *multiplicities)
+{
+    Rows rows(dataset, proximity_measure, multiplicities);
+    vector<char> kept(rows.size(), false);
+    vector<int> nearest(rows.size(), -1);
+    vector<float> distances(rows.size(), numeric_limits<float>::max());
+
+    for (vector<int> added = rows.centers(); not added.empty();)
+    {
+        for (auto &&i : added)
+        {
+            kept[i] = true;
+        }
+
+        // only the prototypes added by the last pass can be nearer than the current nearest one.
+        parallel(rows.size(), threads, [&](size_t begin, size_t end)
+                 {
+            for (size_t i = begin; i < end; i++)
+            {
+                if (kept[i])
+                    continue;
+                for (auto &&j : added)
+                {
+                    float distance = rows(i, j);
+                    if (distance < distances[i])
+                    {
+                        distances[i] = distance;
+                        nearest[i] = j;
+                    }
+                }
+            } });
+
+        // the representative of a prototype: the nearest of the rows it misclassifies.
+        unordered_map<int, int> representatives;
+        for (int i = 0; i < rows.size(); i++)
+        {
+            if (kept[i] or rows.labels[i] == rows.labels[nearest[i]])
+                continue;
+            auto representative = representatives.insert(make_pair(nearest[i], i)).first;
+            if (distances[i] < distances[representative->second])
+                representative->second = i;
+        }
+        added.clear();
+        for (auto &&i : representatives)
+        {
+            added.push_back(i.second);
+        }
+    }
+    return kept_rows(kept);
+}
+
+vector<int> edited_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &),
+    unsigned int k, unsigned int threads, const vector<LabelCounts> *multiplicities)
+{
+    Rows rows(dataset, proximity_measure, multiplicities);
+    vector<char> kept(rows.size(), false);
+    k = min<unsigned int>(max(k, 1u), max(rows.size() - 1, 0));
+
+    parallel(rows.size(), threads, [&](size_t begin, size_t end)
+             {
+        for (size_t i = begin; i < end; i++)
+        {
+            priority_queue<pair<float, int>> best; // a max-heap of the k nearest other rows.
+            for (int j = 0; j < rows.size() and k; j++)
+            {
+                if (j == (int)i)
+                    continue;
+                float distance = rows(i, j);
+                if (best.size() < k)
+                    best.push(make_pair(distance, j));
+                else if (distance < best.top().first)
+                {
+                    best.pop();
+                    best.push(make_pair(distance, j));
+                }
+            }
+            vector<int> neighbors;
+            for (; not best.empty(); best.pop())
+            {
+                neighbors.push_back(best.top().second);
+            }
+            reverse(neighbors.begin(), neighbors.end());
+            kept[i] = majority(rows, i, neighbors, k);
+        } });
+    return kept_rows(kept);
+}
+
+vector<int> fast_edited_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int k,
+    const vector<LabelCounts> *multiplicities)
+{
+    Rows rows(dataset, proximity_measure, multiplicities);
+    // NN-Descent converges poorly with very few neighbors per row, the graph keeps at least 10.
+    k = max(k, 1u);
+    KNNGraph graph(max(k, 10u));
+    graph.build(dataset, proximity_measure);
+
+    vector<char> kept(rows.size(), true);
+    for (int i = 0; i < rows.size() and rows.size() > 1; i++)
+    {
+        vector<int> neighbors;
+        for (auto &&j : graph.neighbors(i))
+        {
+            neighbors.push_back(j.second);
+        }
+        kept[i] = majority(rows, i, neighbors, k);
+    }
+    return kept_rows(kept);
+}
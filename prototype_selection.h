@@ -0,0 +1,100 @@
+#ifndef H_PROTOTYPE_SELECTION
+#define H_PROTOTYPE_SELECTION
+/**
+ * @file prototype_selection.cpp
+ * @brief Implementation of training-set reduction for nearest neighbor classifiers.
+ *
+ * This file provides prototype-selection passes that pick the subset of a labelled dataset worth keeping.
+ * Condensing keeps the rows near the decision boundaries, enough for 1-NN to classify every dropped row correctly:
+ * Hart's condensed nearest neighbor adds misclassified rows one at a time, and the fast condensed nearest neighbor
+ * (FCNN) adds, for every prototype, the nearest of the rows it misclassifies, one batch per pass with the nearest
+ * prototype of every row updated in parallel. Editing does the opposite and drops the noisy rows misclassified by
+ * their k nearest neighbors (Wilson), either by exact parallel scans or from the approximate kNN graph of `KNNGraph`.
+ *
+ * Every pass takes the normalized dataset and the proximity measure of the classifier and returns the kept row
+ * indices in increasing order. With `euclidean_distance_mesure` distances are computed on packed features.
+ * A deduplicated dataset comes with the label counts of its rows: a row then belongs to its most frequent label
+ * and casts one vote per copy, and keeping or dropping it keeps or drops all of its copies.
+ */
+
+#include "dataset.h"
+
+/**
+ * @brief The labels of the identical rows collapsed into one deduplicated row, with their counts.
+ */
+using LabelCounts = vector<pair<Dataset::DataType, int>>;
+
+/**
+ * @brief The prototype-selection passes applied by `KNN::reduce`.
+ */
+enum class PrototypeSelection
+{
+    condensed,      /**< `condensed_nearest_neighbor`. */
+    fast_condensed, /**< `fast_condensed_nearest_neighbor`. */
+    edited,         /**< `edited_nearest_neighbor`. */
+    fast_edited     /**< `fast_edited_nearest_neighbor`. */
+};
+
+/**
+ * @brief Hart's condensed nearest neighbor.
+ *
+ * Starting from the first row of every class, rows misclassified by their nearest kept row are kept, in row
+ * order, until a pass over the dataset keeps none.
+ *
+ * @param dataset The normalized dataset, with its label set.
+ * @param proximity_measure The distance between rows.
+ * @param multiplicities The label counts of every row, or a null pointer when every row is a single copy.
+ * @return The kept rows.
+ */
+vector<int> condensed_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &),
+    const vector<LabelCounts> *multiplicities = nullptr);
+
+/**
+ * @brief The fast condensed nearest neighbor (FCNN1) of Angiulli.
+ *
+ * Starts from the row nearest to the centroid of every class (the first row of every class with a measure other
+ * than the Euclidean one); each pass then keeps, for every kept row, the nearest of the rows it is the nearest
+ * kept row of but does not share the label of. The result is consistent, like Hart's, and independent of the row
+ * order, and the number of passes is usually logarithmic in the number of rows.
+ *
+ * @param dataset The normalized dataset, with its label set.
+ * @param proximity_measure The distance between rows.
+ * @param threads The number of threads, 0 for the hardware concurrency (default is 0).
+ * @param multiplicities The label counts of every row, or a null pointer when every row is a single copy.
+ * @return The kept rows.
+ */
+vector<int> fast_condensed_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int threads = 0,
+    const vector<LabelCounts> *multiplicities = nullptr);
+
+/**
+ * @brief Wilson's edited nearest neighbor, with exact neighbors.
+ *
+ * Drops every row whose label is not the majority label of its k nearest other rows. Rows are scanned in parallel.
+ *
+ * @param dataset The normalized dataset, with its label set.
+ * @param proximity_measure The distance between rows.
+ * @param k The number of neighbors voting (default is 3).
+ * @param threads The number of threads, 0 for the hardware concurrency (default is 0).
+ * @param multiplicities The label counts of every row, or a null pointer when every row is a single copy.
+ * @return The kept rows.
+ */
+vector<int> edited_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &),
+    unsigned int k = 3, unsigned int threads = 0, const vector<LabelCounts> *multiplicities = nullptr);
+
+/**
+ * @brief Wilson's edited nearest neighbor over the approximate neighbors of an NN-Descent kNN graph.
+ *
+ * @param dataset The normalized dataset, with its label set.
+ * @param proximity_measure The distance between rows.
+ * @param k The number of neighbors voting (default is 3).
+ * @param multiplicities The label counts of every row, or a null pointer when every row is a single copy.
+ * @return The kept rows.
+ */
+vector<int> fast_edited_nearest_neighbor(
+    Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int k = 3,
+    const vector<LabelCounts> *multiplicities = nullptr);
+
+#endif
@@ -0,0 +1,114 @@
+#include "quantized_index.h"
+#include <queue>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    /**
+     * @brief The squared L2 distance between two rows of codes, stride a multiple of 16.
+     */
+    uint32_t squared_distance(const uint8_t *a, const uint8_t *b, size_t stride)
+    {
+#if defined(__SSE2__)
+        // widen the bytes to 16 bits, subtract, and let madd square and add adjacent pairs into 32 bits.
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = zero;
+        for (size_t i = 0; i < stride; i += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i)), y = _mm_loadu_si128((const __m128i *)(b + i));
+            __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero));
+            __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero));
+            sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(sum);
+#else
+        uint32_t sum = 0;
+        for (size_t i = 0; i < stride; i++)
+        {
+            int d = (int)a[i] - (int)b[i];
+            sum += d * d;
+        }
+        return sum;
+#endif
+    }
+}
+
+QuantizedIndex::QuantizedIndex(unsigned int overfetch) : _overfetch{max(overfetch, 1u)}
+{
+}
+
+uint8_t QuantizedIndex::quantize(double value)
+{
+    return (uint8_t)lround(min(max(value, 0.0), 1.0) * 255);
+}
+
+void QuantizedIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != dataset.get_label() and find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            _attributes.push_back(i);
+    }
+
+    _rows = dataset.no_rows();
+    _stride = (_attributes.size() + 15) / 16 * 16;
+    _codes.assign(_rows * _stride, 0);
+    for (size_t j = 0; j < _attributes.size(); j++)
+    {
+        auto &values = dataset[keys[_attributes[j]]];
+        for (int i = 0; i < _rows; i++)
+        {
+            _codes[i * _stride + j] = quantize(get<double>(values[i]));
+        }
+    }
+}
+
+vector<pair<double, int>> QuantizedIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    vector<uint8_t> query(_stride, 0);
+    for (size_t j = 0; j < _attributes.size(); j++)
+    {
+        query[j] = quantize(get<double>(target[column(dataset, target, _attributes[j])]));
+    }
+
+    // a max-heap of the best candidates so far.
+    size_t fetch = min<size_t>((size_t)k * _overfetch, _rows);
+    priority_queue<pair<uint32_t, int>> best;
+    for (int i = 0; i < _rows and fetch > 0; i++)
+    {
+        uint32_t distance = squared_distance(_codes.data() + i * _stride, query.data(), _stride);
+        if (best.size() < fetch)
+            best.push(make_pair(distance, i));
+        else if (distance < best.top().first)
+        {
+            best.pop();
+            best.push(make_pair(distance, i));
+        }
+    }
+
+    vector<int> candidates;
+    for (; not best.empty(); best.pop())
+    {
+        candidates.push_back(best.top().second);
+    }
+    return rerank(dataset, target, candidates, k, proximity_measure);
+}
+
+shared_ptr<SearchIndex> QuantizedIndex::clone() const
+{
+    return make_shared<QuantizedIndex>(_overfetch);
+}
+
+size_t QuantizedIndex::codes_size() const
+{
+    return _codes.size();
+}
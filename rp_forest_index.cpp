@@ -0,0 +1,381 @@
+#include "rp_forest_index.h"
+#include "binary_io.h"
+#include "kmeans.h"
+#include <queue>
+#include <random>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    const char rp_forest_magic[8] = {'K', 'N', 'N', 'R', 'P', 'F', 0, 0};
+    const uint32_t rp_forest_version = 1;
+    const size_t header_size = sizeof(rp_forest_magic) + 7 * sizeof(uint32_t) + sizeof(uint64_t);
+
+    float dot(const float *a, const float *b, size_t dim)
+    {
+        float sum = 0;
+        for (size_t i = 0; i < dim; i++)
+        {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    /**
+     * @brief Hash the vectors and the parameters that shape the trees, so a file built otherwise is not reused.
+     */
+    uint64_t fingerprint(const vector<float> &data, uint32_t dim, uint32_t rows, uint32_t trees, uint32_t leaf_size)
+    {
+        uint64_t hash = 1469598103934665603ull ^ ((uint64_t)dim << 32 | rows);
+        hash = (hash ^ ((uint64_t)trees << 32 | leaf_size)) * 1099511628211ull;
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+        for (size_t i = 0; i < data.size() * sizeof(float); i++)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief One tree, built on its own before the trees are concatenated.
+     */
+    struct Tree
+    {
+        vector<int32_t> left, right;
+        vector<float> offsets, planes;
+        vector<uint32_t> leaf_begin, leaf_count, entries;
+        int32_t root = 0;
+    };
+
+    /**
+     * @brief Split rows[begin, end) and return the code of the subtree: a node index, or ~leaf.
+     */
+    int32_t grow(Tree &tree, vector<uint32_t> &rows, size_t begin, size_t end, const float *data, size_t dim, size_t leaf_size, mt19937 &generator)
+    {
+        size_t count = end - begin;
+        if (count <= leaf_size)
+        {
+            tree.leaf_begin.push_back(tree.entries.size());
+            tree.leaf_count.push_back(count);
+            tree.entries.insert(tree.entries.end(), rows.begin() + begin, rows.begin() + end);
+            return ~(int32_t)(tree.leaf_count.size() - 1);
+        }
+
+        // the hyperplane equidistant from two random rows; a few tries before falling back to a random halving.
+        vector<float> normal(dim, 0.0f);
+        float offset = 0;
+        size_t middle = begin;
+        for (int attempt = 0; attempt < 3 and (middle == begin or middle == end); attempt++)
+        {
+            uniform_int_distribution<size_t> pick(begin, end - 1);
+            const float *a = data + (size_t)rows[pick(generator)] * dim, *b = data + (size_t)rows[pick(generator)] * dim;
+            offset = 0;
+            for (size_t i = 0; i < dim; i++)
+            {
+                normal[i] = a[i] - b[i];
+                offset += normal[i] * (a[i] + b[i]) / 2;
+            }
+            middle = partition(rows.begin() + begin, rows.begin() + end, [&](uint32_t row)
+                               { return dot(normal.data(), data + (size_t)row * dim, dim) <= offset; }) -
+                     rows.begin();
+        }
+        if (middle == begin or middle == end)
+        {
+            fill(normal.begin(), normal.end(), 0.0f);
+            offset = 0;
+            shuffle(rows.begin() + begin, rows.begin() + end, generator);
+            middle = begin + count / 2;
+        }
+
+        int32_t node = tree.left.size();
+        tree.left.push_back(0);
+        tree.right.push_back(0);
+        tree.offsets.push_back(offset);
+        tree.planes.insert(tree.planes.end(), normal.begin(), normal.end());
+        int32_t left = grow(tree, rows, begin, middle, data, dim, leaf_size, generator);
+        int32_t right = grow(tree, rows, middle, end, data, dim, leaf_size, generator);
+        tree.left[node] = left;
+        tree.right[node] = right;
+        return node;
+    }
+}
+
+RPForestIndex::RPForestIndex(const string &path, unsigned int trees, unsigned int leaf_size, unsigned int budget, unsigned int refine)
+    : _path{path}, _trees{max(trees, 1u)}, _leaf_size{max(leaf_size, 1u)}, _budget{budget}, _refine{refine}
+{
+}
+
+RPForestIndex::~RPForestIndex()
+{
+    unmap();
+}
+
+void RPForestIndex::unmap()
+{
+    if (_mapping)
+        munmap(_mapping, _size);
+    _mapping = nullptr;
+    _size = 0;
+}
+
+bool RPForestIndex::map(uint64_t expected)
+{
+    unmap();
+    int fd = open(_path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &status) < 0 or (size_t)status.st_size < header_size)
+    {
+        close(fd);
+        return false;
+    }
+
+    _size = status.st_size;
+    _mapping = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_mapping == MAP_FAILED)
+    {
+        _mapping = nullptr;
+        return false;
+    }
+
+    const char *base = (const char *)_mapping, *cursor = base + sizeof(rp_forest_magic);
+    uint32_t version = read_pod<uint32_t>(cursor);
+    _dim = read_pod<uint32_t>(cursor);
+    _rows = read_pod<uint32_t>(cursor);
+    _tree_count = read_pod<uint32_t>(cursor);
+    uint32_t nodes = read_pod<uint32_t>(cursor), leaves = read_pod<uint32_t>(cursor);
+    uint64_t entries = read_pod<uint32_t>(cursor), fingerprint = read_pod<uint64_t>(cursor);
+
+    size_t expected_size = header_size + 4 * ((size_t)_tree_count + 3 * nodes + (size_t)nodes * _dim + 2 * leaves + entries + (size_t)_rows * _dim);
+    if (not equal(rp_forest_magic, rp_forest_magic + 8, base) or version != rp_forest_version or _size != expected_size or
+        (expected and fingerprint != expected))
+    {
+        unmap();
+        return false;
+    }
+
+    cursor = base + header_size;
+    _roots = (const int32_t *)cursor;
+    _nodes = (const Node *)(_roots + _tree_count);
+    _planes = (const float *)(_nodes + nodes);
+    _leaves = (const Leaf *)(_planes + (size_t)nodes * _dim);
+    _entries = (const uint32_t *)(_leaves + leaves);
+    _vectors = (const float *)(_entries + entries);
+
+    // queries walk the sections without checks. Children must point past their node, so a corrupt file cannot loop.
+    auto valid = [&](int32_t child, int64_t parent)
+    { return child >= 0 ? child > parent and (uint32_t)child < nodes : (uint32_t)~child < leaves; };
+    bool sound = true;
+    for (uint32_t i = 0; sound and i < _tree_count; i++)
+    {
+        sound = valid(_roots[i], -1);
+    }
+    for (uint32_t i = 0; sound and i < nodes; i++)
+    {
+        sound = valid(_nodes[i].left, i) and valid(_nodes[i].right, i);
+    }
+    for (uint32_t i = 0; sound and i < leaves; i++)
+    {
+        sound = (uint64_t)_leaves[i].begin + _leaves[i].count <= entries;
+    }
+    for (uint64_t i = 0; sound and i < entries; i++)
+    {
+        sound = _entries[i] < _rows;
+    }
+    if (not sound)
+    {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void RPForestIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] != dataset.get_label() and find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            _attributes.push_back(i);
+    }
+
+    uint32_t dim = _attributes.size(), rows = dataset.no_rows();
+    vector<float> data((size_t)rows * dim);
+    for (size_t j = 0; j < dim; j++)
+    {
+        auto &values = dataset[keys[_attributes[j]]];
+        for (uint32_t i = 0; i < rows; i++)
+        {
+            data[(size_t)i * dim + j] = get<double>(values[i]);
+        }
+    }
+
+    // another process may already have built the file for the same vectors.
+    uint64_t print = fingerprint(data, dim, rows, _trees, _leaf_size);
+    if (map(print))
+        return;
+
+    vector<Tree> trees(_trees);
+    unsigned int threads = max(min(thread::hardware_concurrency(), _trees), 1u);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            for (unsigned int i = t; i < _trees; i += threads)
+            {
+                mt19937 generator(i);
+                vector<uint32_t> order(rows);
+                iota(order.begin(), order.end(), 0);
+                trees[i].root = grow(trees[i], order, 0, rows, data.data(), dim, _leaf_size, generator);
+            } });
+    }
+    for (auto &&i : workers)
+    {
+        i.join();
+    }
+
+    // concatenate the trees, shifting their node, leaf and entry numbers.
+    vector<int32_t> roots;
+    vector<Node> nodes;
+    vector<float> planes;
+    vector<Leaf> leaves;
+    vector<uint32_t> entries;
+    for (auto &&tree : trees)
+    {
+        int32_t node_base = nodes.size(), leaf_base = leaves.size();
+        uint32_t entry_base = entries.size();
+        auto shift = [&](int32_t child)
+        { return child >= 0 ? child + node_base : ~(~child + leaf_base); };
+
+        roots.push_back(shift(tree.root));
+        for (size_t i = 0; i < tree.left.size(); i++)
+        {
+            nodes.push_back(Node{shift(tree.left[i]), shift(tree.right[i]), tree.offsets[i]});
+        }
+        planes.insert(planes.end(), tree.planes.begin(), tree.planes.end());
+        for (size_t i = 0; i < tree.leaf_begin.size(); i++)
+        {
+            leaves.push_back(Leaf{tree.leaf_begin[i] + entry_base, tree.leaf_count[i]});
+        }
+        entries.insert(entries.end(), tree.entries.begin(), tree.entries.end());
+    }
+
+    // written aside and renamed over the old file, which stays valid for whoever still maps it.
+    string temporary = _path + ".tmp" + to_string(getpid());
+    {
+        ofstream out(temporary, ios::binary | ios::out | ios::trunc);
+        out.write(rp_forest_magic, sizeof(rp_forest_magic));
+        write_pod<uint32_t>(out, rp_forest_version);
+        write_pod<uint32_t>(out, dim);
+        write_pod<uint32_t>(out, rows);
+        write_pod<uint32_t>(out, roots.size());
+        write_pod<uint32_t>(out, nodes.size());
+        write_pod<uint32_t>(out, leaves.size());
+        write_pod<uint32_t>(out, entries.size());
+        write_pod<uint64_t>(out, print);
+        out.write((const char *)roots.data(), roots.size() * sizeof(int32_t));
+        out.write((const char *)nodes.data(), nodes.size() * sizeof(Node));
+        out.write((const char *)planes.data(), planes.size() * sizeof(float));
+        out.write((const char *)leaves.data(), leaves.size() * sizeof(Leaf));
+        out.write((const char *)entries.data(), entries.size() * sizeof(uint32_t));
+        out.write((const char *)data.data(), data.size() * sizeof(float));
+        if (not out)
+        {
+            out.close();
+            remove(temporary.c_str());
+            throw runtime_error(temporary + " : could not write the random-projection forest.\n");
+        }
+    }
+    if (rename(temporary.c_str(), _path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        throw runtime_error(_path + " : could not replace the random-projection forest.\n");
+    }
+    if (not map(print))
+        throw runtime_error(_path + " : could not map the random-projection forest.\n");
+}
+
+vector<pair<double, int>> RPForestIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    if (not _mapping)
+        throw runtime_error(_path + " : the random-projection forest is not built.\n");
+    if (_rows == 0 or k == 0)
+        return {};
+
+    vector<float> query(_dim);
+    for (size_t j = 0; j < _dim; j++)
+    {
+        query[j] = get<double>(target[column(dataset, target, _attributes[j])]);
+    }
+
+    // best-first over all trees, by the distance to the nearest hyperplane crossed on the way down.
+    size_t budget = _budget ? _budget : (size_t)_tree_count * k * 4;
+    priority_queue<pair<float, int32_t>> queue;
+    for (uint32_t i = 0; i < _tree_count; i++)
+    {
+        queue.push(make_pair(numeric_limits<float>::max(), _roots[i]));
+    }
+
+    vector<uint32_t> candidates;
+    while (not queue.empty() and candidates.size() < budget)
+    {
+        auto top = queue.top();
+        queue.pop();
+        if (top.second < 0)
+        {
+            const Leaf &leaf = _leaves[~top.second];
+            candidates.insert(candidates.end(), _entries + leaf.begin, _entries + leaf.begin + leaf.count);
+            continue;
+        }
+        const Node &node = _nodes[top.second];
+        float margin = dot(_planes + (size_t)top.second * _dim, query.data(), _dim) - node.offset;
+        queue.push(make_pair(min(top.first, margin), node.right));
+        queue.push(make_pair(min(top.first, -margin), node.left));
+    }
+
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    vector<pair<double, int>> res;
+    for (auto &&i : candidates)
+    {
+        res.push_back(make_pair(squared_l2(query.data(), _vectors + (size_t)i * _dim, _dim), i));
+    }
+    size_t fetch = min(res.size(), _refine ? (size_t)k * _refine : k);
+    partial_sort(res.begin(), res.begin() + fetch, res.end());
+    res.resize(fetch);
+
+    if (_refine)
+    {
+        vector<int> rows;
+        for (auto &&i : res)
+        {
+            rows.push_back(i.second);
+        }
+        return rerank(dataset, target, rows, k, proximity_measure);
+    }
+    for (auto &&i : res)
+    {
+        i.first = sqrt(i.first);
+    }
+    return res;
+}
+
+shared_ptr<SearchIndex> RPForestIndex::clone() const
+{
+    return make_shared<RPForestIndex>(_path, _trees, _leaf_size, _budget, _refine);
+}
@@ -0,0 +1,115 @@
+#ifndef H_RP_FOREST_INDEX
+#define H_RP_FOREST_INDEX
+/**
+ * @file rp_forest_index.cpp
+ * @brief Implementation of a forest of random-projection trees kept in a memory-mapped file.
+ *
+ * This file contains the implementation of the `RPForestIndex` class. Each tree splits the rows recursively by the
+ * hyperplane equidistant from two random rows until a leaf holds at most `leaf_size` rows. The trees are built in
+ * parallel and written, with the feature vectors, to a single file that is then mapped read-only: every process
+ * serving the same model maps the same file and shares one copy of it in the page cache. A query walks all trees
+ * at once, best-first by distance to the splitting hyperplanes, until the candidate budget is collected.
+ *
+ * File layout (native types, 4-byte aligned): header (magic "KNNRPF", version, dimension, rows, trees, nodes,
+ * leaves, leaf entries, fingerprint of the vectors and of the tree parameters), then the roots, the nodes (children
+ * and offset), the node hyperplanes, the leaves (first entry and count), the leaf entries, and the feature vectors of
+ * the rows.
+ */
+
+#include "search_index.h"
+#include <cstdint>
+
+/**
+ * @brief An Annoy-style forest of random-projection trees over the normalized numeric features.
+ *
+ * Building over a dataset whose vectors match those of an existing file at the same path, with the same number of
+ * trees and leaf size, maps that file instead of rebuilding, so serving processes only pay for the mapping. A rebuild replaces the file atomically; indexes
+ * still mapping the old one keep it alive until they are dropped.
+ */
+class RPForestIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs a random-projection forest.
+     *
+     * @param path The path of the index file.
+     * @param trees The number of trees (default is 10).
+     * @param leaf_size The maximum number of rows in a leaf (default is 32).
+     * @param budget The number of candidates collected per query, 0 for trees * k * 4 (default is 0).
+     * @param refine The number of candidates reranked exactly, as a multiple of k, 0 to skip (default is 2).
+     */
+    RPForestIndex(const string &path, unsigned int trees = 10, unsigned int leaf_size = 32, unsigned int budget = 0, unsigned int refine = 2);
+
+    /**
+     * @brief Unmaps the index file.
+     */
+    ~RPForestIndex();
+
+    RPForestIndex(const RPForestIndex &) = delete;
+    RPForestIndex &operator=(const RPForestIndex &) = delete;
+
+    /**
+     * @brief Map the forest file of the dataset's vectors, building and writing it first if needed.
+     *
+     * @throw runtime_error If the file cannot be written, replaced or mapped; no temporary file is left behind.
+     */
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    /**
+     * @brief Collect candidates best-first over all trees and rank them, reranking with the measure if `refine` is set.
+     *
+     * @throw runtime_error If the forest was never built.
+     */
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+private:
+    /**
+     * @brief A split node: children are node indices, or ~leaf for leaves.
+     */
+    struct Node
+    {
+        int32_t left, right; /**< The children below and above the hyperplane. */
+        float offset;        /**< The hyperplane offset along its normal. */
+    };
+
+    /**
+     * @brief A leaf: a run of leaf entries.
+     */
+    struct Leaf
+    {
+        uint32_t begin, count; /**< The first entry and the number of entries. */
+    };
+
+    string _path;                                  /**< The path of the index file. */
+    unsigned int _trees, _leaf_size, _budget, _refine; /**< The parameters. */
+    vector<int> _attributes;                       /**< The positions of the numeric, non-label attributes. */
+
+    void *_mapping = nullptr; /**< The mapped file. */
+    size_t _size = 0;         /**< The size of the mapping. */
+    uint32_t _dim = 0, _rows = 0, _tree_count = 0;
+    const int32_t *_roots = nullptr;
+    const Node *_nodes = nullptr;
+    const float *_planes = nullptr;
+    const Leaf *_leaves = nullptr;
+    const uint32_t *_entries = nullptr;
+    const float *_vectors = nullptr;
+
+    /**
+     * @brief Map an index file and point the sections into it.
+     *
+     * @param fingerprint The expected fingerprint of the vectors, 0 to accept any.
+     * @return false if the file is missing, malformed, or does not match.
+     */
+    bool map(uint64_t fingerprint);
+
+    /**
+     * @brief Release the mapping.
+     */
+    void unmap();
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "search_index.h"
+
+vector<pair<double, int>> SearchIndex::rerank(
+    Dataset &dataset, const vector<Dataset::DataType> &target, const vector<int> &candidates, unsigned int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    vector<pair<double, int>> res;
+
+    for (auto &&i : candidates)
+    {
+        res.push_back(make_pair(proximity_measure(&dataset, dataset.iterrow(i), target), i));
+    }
+
+    k = min<size_t>(k, res.size());
+    partial_sort(res.begin(), res.begin() + k, res.end());
+    res.resize(k);
+
+    return res;
+}
+
+int SearchIndex::column(const Dataset &dataset, const vector<Dataset::DataType> &data_point, int attribute)
+{
+    auto keys = dataset.get_attributes();
+    if (data_point.size() == keys.size())
+        return attribute;
+
+    int l = find(keys.begin(), keys.end(), dataset.get_label()) - keys.begin();
+    return attribute > l ? attribute - 1 : attribute;
+}
+
+bool SearchIndex::valid_attributes(const Dataset &dataset, const vector<int> &attributes)
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    for (auto &&i : attributes)
+    {
+        if (i < 0 or i >= (int)keys.size() or keys[i] == dataset.get_label() or
+            find(numerics.begin(), numerics.end(), keys[i]) == numerics.end())
+            return false;
+    }
+    return true;
+}
+
+int SearchIndex::string_column(const Dataset &dataset, const string &attribute)
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        bool categorical = find(numerics.begin(), numerics.end(), keys[i]) == numerics.end();
+        if (categorical and keys[i] != dataset.get_label() and (attribute.empty() or keys[i] == attribute))
+            return i;
+    }
+
+    if (attribute.empty())
+        throw invalid_argument("the dataset has no categorical attribute to index.\n");
+    throw invalid_argument(attribute + " is not a categorical, non-label attribute of the dataset.\n");
+}
@@ -0,0 +1,150 @@
+#ifndef H_SEARCH_INDEX
+#define H_SEARCH_INDEX
+/**
+ * @file search_index.cpp
+ * @brief Implementation of the SearchIndex base class for KNN search backends.
+ *
+ * This file provides the abstract base class `SearchIndex`. A search index is built once over the training dataset
+ * of a published KNN snapshot and then answers k-nearest neighbor queries in place of the brute-force scan.
+ * Derived classes implement specific index structures.
+ *
+ * Indexes rank by distance (smaller is nearer). Exact indexes return the same neighbors as a scan with the proximity
+ * measure they are paired with; approximate ones generate candidates and rerank them with that measure.
+ */
+
+#include "dataset.h"
+#include <memory>
+
+/**
+ * @brief Abstract base class for KNN search backends.
+ */
+class SearchIndex
+{
+public:
+    /**
+     * @brief Build the index over a (normalized) training dataset.
+     *
+     * @param dataset The dataset to index.
+     * @param proximity_measure The proximity measure queries will be answered with.
+     */
+    virtual void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) = 0;
+
+    /**
+     * @brief Find the k nearest neighbors of a target.
+     *
+     * Must be safe to call from several threads at once.
+     *
+     * @param dataset The dataset the index was built over.
+     * @param target The normalized target data point, with or without the label value.
+     * @param k The number of nearest neighbors to return.
+     * @param proximity_measure The proximity measure of the KNN classifier.
+     * @return Vector of pairs: distance and data point index, nearest first.
+     */
+    virtual vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const = 0;
+
+    /**
+     * @brief Find the k nearest neighbors of a target with a per-query search effort.
+     *
+     * @param nprobe The number of lists an inverted-file index visits for this query, 0 for the index's own setting.
+     * Indexes without lists ignore it (the default).
+     */
+    virtual vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &), unsigned int) const
+    {
+        return search(dataset, target, k, proximity_measure);
+    }
+
+    /**
+     * @brief Construct an empty index with the same parameters, to be built over another dataset.
+     *
+     * @return The new, unbuilt index.
+     */
+    virtual shared_ptr<SearchIndex> clone() const = 0;
+
+    /**
+     * @brief Whether the index returns the same neighbors as a scan with a metric proximity measure.
+     *
+     * @return false for approximate indexes (the default), true for exact ones.
+     */
+    virtual bool exact() const
+    {
+        return false;
+    }
+
+    /**
+     * @brief Write the built index to a binary stream, so that it can be restored without a rebuild.
+     *
+     * @param out The stream to write to.
+     * @return false if the index does not support persistence, true otherwise.
+     */
+    virtual bool save(ostream &) const
+    {
+        return false;
+    }
+
+    /**
+     * @brief Restore an index written by `save` over the dataset it was built for.
+     *
+     * @param in The stream to read from.
+     * @param dataset The dataset the index was built over.
+     * @return false if the index does not support persistence or the stream does not match, true otherwise.
+     */
+    virtual bool load(istream &, Dataset &)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Virtual destructor.
+     */
+    virtual ~SearchIndex() {}
+
+protected:
+    /**
+     * @brief Score candidate rows with the proximity measure and keep the k nearest.
+     *
+     * @param dataset The indexed dataset.
+     * @param target The normalized target data point.
+     * @param candidates The candidate row indices.
+     * @param k The number of nearest neighbors to return.
+     * @param proximity_measure The proximity measure.
+     * @return Vector of pairs: distance and data point index, nearest first.
+     */
+    static vector<pair<double, int>> rerank(
+        Dataset &dataset, const vector<Dataset::DataType> &target, const vector<int> &candidates, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &));
+
+    /**
+     * @brief Position of an attribute's value in a data point that may lack the label value.
+     *
+     * @param dataset The indexed dataset.
+     * @param data_point The data point.
+     * @param attribute The position of the attribute among the dataset's attributes.
+     * @return The position of the value in the data point.
+     */
+    static int column(const Dataset &dataset, const vector<Dataset::DataType> &data_point, int attribute);
+
+    /**
+     * @brief Check that attribute positions read from a file name numeric, non-label attributes of the dataset.
+     *
+     * @param dataset The indexed dataset.
+     * @param attributes The positions of the attributes.
+     * @return true if every position is valid.
+     */
+    static bool valid_attributes(const Dataset &dataset, const vector<int> &attributes);
+
+    /**
+     * @brief Find the string attribute indexed by a text index.
+     *
+     * @param dataset The indexed dataset.
+     * @param attribute The name of the attribute, or empty for the first categorical, non-label attribute.
+     * @return The position of the attribute among the dataset's attributes.
+     * @throw invalid_argument If the attribute is missing, numeric or the label, or if there is no categorical attribute.
+     */
+    static int string_column(const Dataset &dataset, const string &attribute);
+};
+
+#endif
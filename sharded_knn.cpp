@@ -0,0 +1,412 @@
+#include "sharded_knn.h"
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <list>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+namespace
+{
+    /**
+     * @brief Open a socket on an endpoint, listening on it or connected to it.
+     */
+    int open_socket(const string &endpoint, bool listening)
+    {
+        int fd = -1;
+
+        if (endpoint.compare(0, 5, "unix:") == 0)
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            string path = endpoint.substr(5);
+            if (path.size() >= sizeof(address.sun_path))
+            {
+                throw invalid_argument(endpoint + " : socket path too long.\n");
+            }
+            strcpy(address.sun_path, path.c_str());
+
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listening)
+            {
+                unlink(path.c_str());
+                if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 or listen(fd, SOMAXCONN) < 0)
+                {
+                    close(fd);
+                    throw runtime_error(endpoint + " : " + strerror(errno) + "\n");
+                }
+            }
+            else if (connect(fd, (sockaddr *)&address, sizeof(address)) < 0)
+            {
+                close(fd);
+                throw runtime_error(endpoint + " : " + strerror(errno) + "\n");
+            }
+            return fd;
+        }
+
+        size_t colon = endpoint.rfind(':');
+        if (colon == string::npos)
+        {
+            throw invalid_argument(endpoint + " : expected unix:<path> or <host>:<port>.\n");
+        }
+
+        addrinfo hints{}, *addresses;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = listening ? AI_PASSIVE : 0;
+        if (getaddrinfo(endpoint.substr(0, colon).c_str(), endpoint.substr(colon + 1).c_str(), &hints, &addresses) != 0)
+        {
+            throw runtime_error(endpoint + " : unknown host.\n");
+        }
+
+        for (addrinfo *i = addresses; i != nullptr; i = i->ai_next)
+        {
+            fd = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+            if (fd < 0)
+                continue;
+
+            int yes = 1;
+            if (listening)
+            {
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+                if (bind(fd, i->ai_addr, i->ai_addrlen) == 0 and listen(fd, SOMAXCONN) == 0)
+                    break;
+            }
+            else if (connect(fd, i->ai_addr, i->ai_addrlen) == 0)
+            {
+                // queries are small and latency bound.
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addresses);
+
+        if (fd < 0)
+        {
+            throw runtime_error(endpoint + " : " + strerror(errno) + "\n");
+        }
+        return fd;
+    }
+
+    /**
+     * @brief Read a line from a socket, buffering what comes after it. Returns false once the peer closed.
+     */
+    bool read_line(int fd, string &buffer, string &line)
+    {
+        size_t end;
+        while ((end = buffer.find('\n')) == string::npos)
+        {
+            char chunk[4096];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return false;
+            buffer.append(chunk, n);
+        }
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        return true;
+    }
+
+    void write_all(int fd, const string &data)
+    {
+        for (size_t sent = 0; sent < data.size();)
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                throw runtime_error(string("send : ") + strerror(errno) + "\n");
+            }
+            sent += n;
+        }
+    }
+
+    string encode(const Dataset::DataType &value)
+    {
+        ostringstream out;
+        if (holds_alternative<double>(value))
+        {
+            out << 'd' << setprecision(17) << get<double>(value);
+            return out.str();
+        }
+
+        // tabs and newlines frame the messages, they are escaped inside strings.
+        out << 's';
+        for (auto &&i : get<string>(value))
+        {
+            if (i == '\\')
+                out << "\\\\";
+            else if (i == '\t')
+                out << "\\t";
+            else if (i == '\n')
+                out << "\\n";
+            else
+                out << i;
+        }
+        return out.str();
+    }
+
+    Dataset::DataType decode(const string &field)
+    {
+        if (not field.empty() and field[0] == 'd')
+            return strtod(field.c_str() + 1, nullptr);
+
+        string value;
+        for (size_t i = 1; i < field.size(); i++)
+        {
+            if (field[i] != '\\' or i + 1 == field.size())
+            {
+                value += field[i];
+                continue;
+            }
+            char escaped = field[++i];
+            value += escaped == 't' ? '\t' : escaped == 'n' ? '\n' : escaped;
+        }
+        return value;
+    }
+
+    vector<string> fields(const string &line)
+    {
+        vector<string> res;
+        size_t i = 0, j;
+        while ((j = line.find('\t', i)) != string::npos)
+        {
+            res.push_back(line.substr(i, j - i));
+            i = j + 1;
+        }
+        res.push_back(line.substr(i));
+        return res;
+    }
+}
+
+ShardServer::ShardServer(KNN &knn) : knn{knn}
+{
+}
+
+void ShardServer::serve(const string &endpoint)
+{
+    _stop = false;
+    _listener = open_socket(endpoint, true);
+    // every connection thread with a flag raised once it is done, so that it can be joined.
+    list<pair<thread, shared_ptr<atomic<bool>>>> connections;
+
+    while (not _stop)
+    {
+        int connection = accept(_listener, nullptr, nullptr);
+        if (connection < 0)
+        {
+            if (_stop or errno == EBADF or errno == EINVAL)
+                break;
+            // out of descriptors or memory: wait for connections to close instead of spinning.
+            if (errno != EINTR and errno != ECONNABORTED)
+                this_thread::sleep_for(chrono::milliseconds(50));
+            continue;
+        }
+
+        for (auto i = connections.begin(); i != connections.end();)
+        {
+            if (not *i->second)
+            {
+                ++i;
+                continue;
+            }
+            i->first.join();
+            i = connections.erase(i);
+        }
+        auto done = make_shared<atomic<bool>>(false);
+        connections.emplace_back(thread([this, connection, done]()
+                                        {
+                                            handle(connection);
+                                            *done = true; }),
+                                 done);
+    }
+
+    close(_listener.exchange(-1));
+    for (auto &&i : connections)
+    {
+        i.first.join();
+    }
+}
+
+void ShardServer::stop()
+{
+    _stop = true;
+    // wakes up the blocking accept.
+    int listener = _listener;
+    if (listener >= 0)
+        shutdown(listener, SHUT_RDWR);
+}
+
+void ShardServer::handle(int connection)
+{
+    string buffer, line;
+
+    try
+    {
+        while (read_line(connection, buffer, line))
+        {
+            auto query = fields(line);
+            unsigned int k = stoul(query[0]);
+            vector<Dataset::DataType> target;
+            for (size_t i = 1; i < query.size(); i++)
+            {
+                target.push_back(decode(query[i]));
+            }
+
+            // resolve the labels against the snapshot that was searched; a deduplicated row answers once per copy.
+            auto current = knn.snapshot();
+            auto neighbours = KNN::neighbour_labels(*current, knn.first_knn(*current, target, k), k);
+
+            ostringstream response;
+            response << neighbours.size() << '\n'
+                     << setprecision(17);
+            for (auto &&i : neighbours)
+            {
+                response << i.first << '\t' << encode(i.second) << '\n';
+            }
+            write_all(connection, response.str());
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << '\n';
+    }
+    close(connection);
+}
+
+ShardedKNN::ShardedKNN(const vector<string> &endpoints, int k) : _k{(unsigned int)k}
+{
+    for (auto &&i : endpoints)
+    {
+        _connections.push_back(open_socket(i, false));
+        _buffers.emplace_back();
+    }
+}
+
+ShardedKNN::~ShardedKNN()
+{
+    for (auto &&i : _connections)
+    {
+        if (i >= 0)
+            close(i);
+    }
+}
+
+vector<pair<double, Dataset::DataType>> ShardedKNN::first_knn(const vector<Dataset::DataType> &target)
+{
+    if (_broken)
+    {
+        throw runtime_error("the shard connections were closed by an earlier failed query.\n");
+    }
+
+    string query = to_string(_k);
+    for (auto &&i : target)
+    {
+        query += '\t' + encode(i);
+    }
+    query += '\n';
+
+    vector<pair<double, Dataset::DataType>> merged;
+    string line;
+
+    // a failure part way leaves replies unread in the other sockets, so the connections are unusable afterwards.
+    size_t i = 0;
+    try
+    {
+        // broadcast first, so the shards search concurrently.
+        for (auto &&connection : _connections)
+        {
+            write_all(connection, query);
+        }
+
+        for (; i < _connections.size(); i++)
+        {
+            if (not read_line(_connections[i], _buffers[i], line))
+            {
+                throw runtime_error("shard " + to_string(i) + " closed the connection.\n");
+            }
+
+            int m = stoi(line);
+            for (int j = 0; j < m; j++)
+            {
+                if (not read_line(_connections[i], _buffers[i], line))
+                {
+                    throw runtime_error("shard " + to_string(i) + " closed the connection.\n");
+                }
+                auto neighbour = fields(line);
+                if (neighbour.size() != 2)
+                {
+                    throw runtime_error("shard " + to_string(i) + " sent a malformed reply.\n");
+                }
+                merged.push_back(make_pair(stod(neighbour[0]), decode(neighbour[1])));
+            }
+        }
+    }
+    catch (const exception &e)
+    {
+        _broken = true;
+        for (auto &&connection : _connections)
+        {
+            close(connection);
+            connection = -1;
+        }
+        if (dynamic_cast<const runtime_error *>(&e))
+            throw;
+        throw runtime_error("shard " + to_string(i) + " sent a malformed reply.\n");
+    }
+
+    unsigned int k = min<size_t>(_k, merged.size());
+    partial_sort(merged.begin(), merged.begin() + k, merged.end(), [](const pair<double, Dataset::DataType> &a, const pair<double, Dataset::DataType> &b)
+                 { return a.first < b.first; });
+    merged.resize(k);
+
+    return merged;
+}
+
+Dataset::DataType ShardedKNN::predict(const vector<Dataset::DataType> &sample)
+{
+    return KNN::vote(first_knn(sample));
+}
+
+unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> ShardedKNN::evaluate(Dataset &testData)
+{
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> confusion_matrix;
+    auto keys = testData.get_attributes();
+    int l = find(keys.begin(), keys.end(), testData.get_label()) - keys.begin();
+
+    for (int i = 0; i < testData.no_rows(); i++)
+    {
+        auto row = testData.iterrow(i);
+        ++confusion_matrix[row[l]][predict(row)];
+    }
+
+    report(confusion_matrix);
+
+    return confusion_matrix;
+}
+
+unsigned int ShardedKNN::get_k() const
+{
+    return _k;
+}
+
+void ShardedKNN::set_k(unsigned int k)
+{
+    _k = k;
+}
+
+void ShardedKNN::train(const Dataset &)
+{
+}
+
+void ShardedKNN::saveModel(const string &)
+{
+}
+
+void ShardedKNN::loadModel(const string &)
+{
+}
@@ -0,0 +1,133 @@
+#ifndef H_SHARDED_KNN
+#define H_SHARDED_KNN
+/**
+ * @file sharded_knn.cpp
+ * @brief Implementation of a sharded KNN deployment over Unix domain or TCP sockets.
+ *
+ * This file contains the implementation of the `ShardServer` and `ShardedKNN` classes. The training set is
+ * partitioned (see `Dataset::partition`) across several worker processes, each serving the k nearest neighbors
+ * of its shard through a `ShardServer`. A `ShardedKNN` coordinator broadcasts every query to all shards, merges
+ * the per-shard top-k lists and votes, which gives the same neighbors as a single KNN over the whole set.
+ *
+ * Endpoints are either `unix:<path>` for a Unix domain socket or `<host>:<port>` for TCP.
+ *
+ * Wire protocol, one line per message, fields separated by tabs, values encoded as `d<number>` or `s<string>`, with
+ * backslashes, tabs and newlines escaped in strings as `\\`, `\t` and `\n`:
+ *  - query:    `<k>\t<value>\t<value>...\n`
+ *  - response: `<m>\n` followed by m lines `<distance>\t<value of the label>\n`, nearest first.
+ */
+
+#include "KNN.h"
+
+/**
+ * @brief Serves the k nearest neighbors of a training shard over a socket.
+ */
+class ShardServer
+{
+public:
+    /**
+     * @brief Constructs a server over a KNN model.
+     *
+     * @param knn The model of the shard; for exact results all shards must share the same normalization bounds.
+     */
+    ShardServer(KNN &knn);
+
+    /**
+     * @brief Listen on an endpoint and answer queries until `stop` is called.
+     *
+     * Each connection is served by its own thread and may carry any number of queries. The threads of closed
+     * connections are joined as new connections are accepted.
+     *
+     * @param endpoint `unix:<path>` or `<host>:<port>`.
+     */
+    void serve(const string &endpoint);
+
+    /**
+     * @brief Make `serve` return once the open connections are closed by their peers.
+     */
+    void stop();
+
+private:
+    KNN &knn;                   /**< The model of the shard. */
+    atomic<bool> _stop{false};  /**< Whether `serve` should return. */
+    atomic<int> _listener{-1};  /**< The listening socket. */
+
+    /**
+     * @brief Answer the queries of a single connection until it is closed.
+     */
+    void handle(int connection);
+};
+
+/**
+ * @brief A KNN classifier that queries several shard servers and merges their results.
+ */
+class ShardedKNN : public Classifier
+{
+public:
+    /**
+     * @brief Connects to the shard servers.
+     *
+     * @param endpoints The endpoints of the shards, `unix:<path>` or `<host>:<port>`.
+     * @param k The number of nearest neighbors to consider (default is 1).
+     */
+    ShardedKNN(const vector<string> &endpoints, int k = 1);
+
+    /**
+     * @brief Closes the connections.
+     */
+    ~ShardedKNN();
+
+    /**
+     * @brief Perform k-nearest neighbor search across all shards.
+     *
+     * @param target The target data point for neighbor search.
+     * @return Pairs of distance and label of the nearest neighbors, nearest first.
+     * @throw runtime_error If a shard cannot be written to, closes its connection or sends a malformed reply. The
+     * unread replies of the other shards would answer the next query, so every connection is closed and this and
+     * any later call throw; connect a new `ShardedKNN` to resume.
+     */
+    vector<pair<double, Dataset::DataType>> first_knn(const vector<Dataset::DataType> &target);
+
+    /**
+     * @brief Predicts the class label for a given sample.
+     *
+     * @param sample The input sample for which to predict the class label.
+     * @return The predicted class label.
+     */
+    Dataset::DataType predict(const vector<Dataset::DataType> &sample) override;
+
+    /**
+     * @brief Evaluate the classifier's performance on a test dataset, return the confusion matrix,
+     * and print a classification report including micro-accuracy, micro-recall, and micro-precision.
+     *
+     * @param testData The dataset used for evaluation, with its label set.
+     * @return A confusion matrix containing counts of actual and predicted labels for each class.
+     */
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> evaluate(Dataset &testData) override;
+
+    /**
+     * @brief Get the value of k.
+     *
+     * @return The value of k.
+     */
+    unsigned int get_k() const;
+
+    /**
+     * @brief Set the value of k.
+     *
+     * @param k The new value to set for k.
+     */
+    void set_k(unsigned int k);
+
+private:
+    unsigned int _k;             /**< The number of nearest neighbors to consider. */
+    vector<int> _connections;    /**< One connected socket per shard. */
+    vector<string> _buffers;     /**< Bytes received from each shard and not consumed yet. */
+    bool _broken = false;        /**< Whether a failed query closed the connections. */
+
+    void train(const Dataset &trainingData) override;
+    void saveModel(const std::string &filePath) override;
+    void loadModel(const std::string &filePath) override;
+};
+
+#endif
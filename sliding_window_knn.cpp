@@ -0,0 +1,176 @@
+#include "sliding_window_knn.h"
+
+SlidingWindowKNN::SlidingWindowKNN(
+    const Dataset &reference, unsigned int capacity, double max_age, int k,
+    double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+    : _k{(unsigned int)k}, _proximity_measure{proximity_measure}, _capacity{capacity},
+      _max_age{chrono::duration_cast<Clock::duration>(chrono::duration<double>(max_age))}
+{
+    if (capacity == 0)
+    {
+        throw range_error("capacity should be > 0.\n");
+    }
+
+    Dataset bounds = reference;
+    bounds.normalize();
+
+    window = bounds.structure();
+    window.resize(capacity);
+    times.resize(capacity);
+
+    auto keys = window.get_attributes();
+    auto numerics = window.get_numerics();
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == window.get_label())
+            _label_index = i;
+        else if (find(numerics.begin(), numerics.end(), keys[i]) != numerics.end() and window.local_parms.count(keys[i] + " nmin"))
+            _numeric.push_back(i);
+    }
+}
+
+void SlidingWindowKNN::widen(const vector<Dataset::DataType> &row)
+{
+    auto keys = window.get_attributes();
+    for (auto &&i : _numeric)
+    {
+        double value = get<double>(row[i]);
+        auto &nmin = window.local_parms.at(keys[i] + " nmin"), &nmax = window.local_parms.at(keys[i] + " nmax");
+        double low = get<double>(nmin), high = get<double>(nmax);
+        if (value >= low and value <= high)
+            continue;
+
+        // the margin of a quarter of the range keeps a steadily drifting attribute from rescaling on every push.
+        double margin = (max(high, value) - min(low, value)) / 4;
+        double new_low = value < low ? value - margin : low, new_high = value > high ? value + margin : high;
+        for (auto &&j : window[keys[i]])
+        {
+            double raw = high > low ? get<double>(j) * (high - low) + low : low;
+            j = (raw - new_low) / (new_high - new_low);
+        }
+        nmin = new_low;
+        nmax = new_high;
+    }
+}
+
+void SlidingWindowKNN::push(const vector<Dataset::DataType> &row, Clock::time_point time)
+{
+    if (_count > 0 and time < times[(_head + _capacity - 1) % _capacity])
+    {
+        throw invalid_argument("the time of a pushed sample should not be earlier than the newest one.\n");
+    }
+
+    auto _row = row;
+    widen(_row);
+    window.renormalize(_row);
+    window.set_row(_head, _row);
+    times[_head] = time;
+
+    _head = (_head + 1) % _capacity;
+    if (_count < _capacity)
+    {
+        ++_count;
+    }
+}
+
+void SlidingWindowKNN::expire(Clock::time_point now)
+{
+    if (_max_age == Clock::duration::zero())
+        return;
+
+    // the oldest live slot sits `_count` slots behind the head.
+    while (_count > 0 and now - times[(_head + _capacity - _count) % _capacity] > _max_age)
+    {
+        --_count;
+    }
+}
+
+vector<pair<double, int>> SlidingWindowKNN::first_knn(
+    const vector<Dataset::DataType> &target, bool (*comparison_fn)(double, double))
+{
+    expire();
+
+    auto _target = target;
+    if (window.is_normalized(_target))
+        window.renormalize(_target);
+
+    vector<pair<double, int>> proxi_measure_res;
+    unsigned int tail = (_head + _capacity - _count) % _capacity;
+
+    for (size_t i = 0; i < _count; i++)
+    {
+        int slot = (tail + i) % _capacity;
+        auto _ = window.iterrow(slot);
+        proxi_measure_res.push_back(make_pair(_proximity_measure(&window, _, _target), slot));
+    }
+
+    unsigned int k = min(_k, _count);
+    partial_sort(proxi_measure_res.begin(), proxi_measure_res.begin() + k, proxi_measure_res.end(), [&](const pair<double, int> &a, const pair<double, int> &b)
+                 { return comparison_fn(a.first, b.first); });
+
+    return vector<pair<double, int>>(proxi_measure_res.begin(), proxi_measure_res.begin() + k);
+}
+
+Dataset::DataType SlidingWindowKNN::predict(const vector<Dataset::DataType> &sample)
+{
+    vector<pair<double, Dataset::DataType>> neighbours;
+
+    for (auto &&i : first_knn(sample))
+    {
+        neighbours.push_back(make_pair(i.first, window[window.get_label()][i.second]));
+    }
+
+    return KNN::vote(neighbours);
+}
+
+unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> SlidingWindowKNN::evaluate(Dataset &testData)
+{
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> confusion_matrix;
+
+    for (int i = 0; i < testData.no_rows(); i++)
+    {
+        auto _actual = testData.iterrow(i)[_label_index];
+        auto _predicted = predict(testData.iterrow(i));
+        ++confusion_matrix[_actual][_predicted];
+    }
+
+    report(confusion_matrix);
+
+    return confusion_matrix;
+}
+
+Dataset &SlidingWindowKNN::get_window()
+{
+    return window;
+}
+
+unsigned int SlidingWindowKNN::size() const
+{
+    return _count;
+}
+
+unsigned int SlidingWindowKNN::get_k() const
+{
+    return _k;
+}
+
+void SlidingWindowKNN::set_k(unsigned int k)
+{
+    _k = k;
+}
+
+void SlidingWindowKNN::train(const Dataset &trainingData)
+{
+    for (int i = 0; i < trainingData.no_rows(); i++)
+    {
+        push(trainingData.iterrow(i));
+    }
+}
+
+void SlidingWindowKNN::saveModel(const string &)
+{
+}
+
+void SlidingWindowKNN::loadModel(const string &)
+{
+}
@@ -0,0 +1,162 @@
+#ifndef H_SLIDING_WINDOW_KNN
+#define H_SLIDING_WINDOW_KNN
+/**
+ * @file sliding_window_knn.cpp
+ * @brief Implementation of a streaming KNN classifier over a sliding window of recent samples.
+ *
+ * This file contains the implementation of the `SlidingWindowKNN` class, a KNN classifier that keeps only
+ * the most recent labelled samples, bounded by count and optionally by age, in a preallocated ring buffer.
+ * The ring buffer is a `Dataset` of fixed size, so samples are stored in the usual column layout and scored
+ * with the same proximity measures and weighted vote as `KNN`.
+ */
+
+#include "KNN.h"
+#include <chrono>
+
+/**
+ * @brief A KNN classifier over the most recent W samples, or the samples of the last T seconds.
+ *
+ * Pushing a sample overwrites the oldest slot once the window is full, and expired samples are dropped
+ * from the tail, so eviction is O(1). Queries only see the live slots.
+ *
+ * The normalization bounds start from the reference dataset and widen, with a margin, whenever a pushed value
+ * falls outside them; the stored samples are then rescaled, so a drifting attribute stays within [0, 1].
+ *
+ * @note Not thread-safe; guard pushes and queries externally when they run on different threads.
+ */
+class SlidingWindowKNN : public Classifier
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    /**
+     * @brief Constructs a sliding-window KNN classifier.
+     *
+     * @param reference A dataset providing the attributes, the label and the initial normalization bounds. Its rows
+     * are only used to compute the bounds when it is not normalized yet; the window starts empty.
+     * @param capacity The maximum number of samples kept (W).
+     * @param max_age The maximum age of a sample in seconds (T), 0 keeps samples regardless of age.
+     * @param k The number of nearest neighbors to consider (default is 1).
+     * @param proximity_measure The proximity measure function (default is Euclidean distance).
+     */
+    SlidingWindowKNN(
+        const Dataset &reference, unsigned int capacity, double max_age = 0, int k = 1,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &) = euclidean_distance_mesure);
+
+    /**
+     * @brief Add a labelled sample to the window, evicting the oldest one if the window is full.
+     *
+     * @param row A data point with a value for every attribute, the label included.
+     * @param time The time the sample was observed (default is now).
+     * @throw invalid_argument If the time is earlier than that of the newest live sample; expiry drops samples
+     * from the tail, so the times of the live samples must not decrease.
+     */
+    void push(const vector<Dataset::DataType> &row, Clock::time_point time = Clock::now());
+
+    /**
+     * @brief Drop the samples older than the maximum age.
+     *
+     * @param now The current time (default is now).
+     */
+    void expire(Clock::time_point now = Clock::now());
+
+    /**
+     * @brief Predicts the class label for a given sample using the live window.
+     *
+     * @param sample The input sample for which to predict the class label.
+     * @return The predicted class label.
+     */
+    Dataset::DataType predict(const vector<Dataset::DataType> &sample) override;
+
+    /**
+     * @brief Evaluate the classifier's performance on a test dataset, return the confusion matrix,
+     * and print a classification report including micro-accuracy, micro-recall, and micro-precision.
+     *
+     * @param testData The dataset used for evaluation.
+     * @return A confusion matrix containing counts of actual and predicted labels for each class.
+     */
+    unordered_map<Dataset::DataType, unordered_map<Dataset::DataType, int>> evaluate(Dataset &testData) override;
+
+    /**
+     * @brief Perform k-nearest neighbor search over the live window.
+     *
+     * Expired samples are dropped first.
+     *
+     * @param target The target data point for neighbor search.
+     * @param comparison_fn A comparison function for sorting neighbors.
+     * @return Vector of pairs: proximity measure(distance or similarity) and slot index in the window.
+     */
+    vector<pair<double, int>> first_knn(
+        const vector<Dataset::DataType> &target, bool (*comparison_fn)(double, double) = [](double a, double b)
+                                                 { return a <= b; });
+
+    /**
+     * @brief Get the window storage.
+     *
+     * Only the slots reported by `first_knn` hold live samples.
+     *
+     * @return A reference to the ring buffer dataset.
+     */
+    Dataset &get_window();
+
+    /**
+     * @brief Retrieves the number of live samples in the window.
+     *
+     * @return The number of live samples.
+     */
+    unsigned int size() const;
+
+    /**
+     * @brief Get the value of k.
+     *
+     * @return The value of k.
+     */
+    unsigned int get_k() const;
+
+    /**
+     * @brief Set the value of k.
+     *
+     * @param k The new value to set for k.
+     */
+    void set_k(unsigned int k);
+
+private:
+    unsigned int _k;                                                                                               /**< The number of nearest neighbors to consider. */
+    double (*_proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &); /**< The proximity measure function. */
+    Dataset window;                                                                                                /**< The ring buffer, preallocated to the capacity. */
+    vector<Clock::time_point> times;                                                                               /**< The observation time of each slot. */
+    unsigned int _capacity;                                                                                        /**< The number of slots (W). */
+    Clock::duration _max_age;                                                                                      /**< The maximum age of a sample (T), zero for none. */
+    unsigned int _head = 0;                                                                                        /**< The next slot to write. */
+    unsigned int _count = 0;                                                                                       /**< The number of live slots, ending right before the head. */
+    int _label_index = 0;                                                                                          /**< The position of the label attribute. */
+    vector<int> _numeric;                                                                                          /**< The positions of the attributes normalized with min-max bounds. */
+
+    /**
+     * @brief Widen the normalization bounds to cover a raw data point, rescaling the stored samples.
+     *
+     * @param row The raw data point.
+     */
+    void widen(const vector<Dataset::DataType> &row);
+
+    /**
+     * @brief Push every row of the provided data into the window, in order.
+     *
+     * @param trainingData The dataset used for training.
+     */
+    void train(const Dataset &trainingData) override;
+    /**
+     * @brief Save the trained model to a file.
+     *
+     * @param filePath The path to the file where the model will be saved.
+     */
+    void saveModel(const std::string &filePath) override;
+    /**
+     * @brief Load a previously trained model from a file.
+     *
+     * @param filePath The path to the file containing the saved model.
+     */
+    void loadModel(const std::string &filePath) override;
+};
+
+#endif
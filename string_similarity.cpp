@@ -0,0 +1,208 @@
+#include "string_similarity.h"
+
+u32string decode_utf8(const string &str)
+{
+    u32string res;
+    res.reserve(str.size());
+
+    for (size_t i = 0; i < str.size();)
+    {
+        unsigned char c = str[i];
+        int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+        char32_t codepoint = length == 1 ? c : length == 2 ? c & 0x1f : length == 3 ? c & 0x0f : c & 0x07;
+
+        bool valid = length > 0 and i + length <= str.size();
+        for (int j = 1; valid and j < length; j++)
+        {
+            unsigned char continuation = str[i + j];
+            valid = (continuation >> 6) == 0x2;
+            codepoint = (codepoint << 6) | (continuation & 0x3f);
+        }
+
+        if (valid)
+        {
+            res.push_back(codepoint);
+            i += length;
+        }
+        else
+        {
+            res.push_back(c);
+            ++i;
+        }
+    }
+    return res;
+}
+
+CharSignature::CharSignature(const string &str)
+{
+    u32string codepoints = decode_utf8(str);
+    sort(codepoints.begin(), codepoints.end());
+    size = codepoints.size();
+
+    for (auto &&c : codepoints)
+    {
+        if (counts.empty() or counts.back().first != c)
+            counts.push_back(make_pair(c, 0));
+        ++counts.back().second;
+
+        uint8_t bit = (c * 0x9e3779b97f4a7c15ull) >> 56;
+        bits[bit >> 6] |= 1ull << (bit & 63);
+    }
+}
+
+namespace
+{
+    /**
+     * @brief Size of the multiset intersection, merging the sorted counts.
+     */
+    uint32_t intersection(const CharSignature &a, const CharSignature &b)
+    {
+        uint32_t res = 0;
+        auto i = a.counts.begin(), j = b.counts.begin();
+
+        while (i != a.counts.end() and j != b.counts.end())
+        {
+            if (i->first < j->first)
+                ++i;
+            else if (j->first < i->first)
+                ++j;
+            else
+                res += min((i++)->second, (j++)->second);
+        }
+        return res;
+    }
+
+    const size_t signature_cache_size = 1 << 16;
+
+    /**
+     * @brief The signatures already built by this thread, by string.
+     */
+    thread_local unordered_map<string, CharSignature> signature_cache;
+
+    const CharSignature &cached_signature(const string &str)
+    {
+        auto found = signature_cache.find(str);
+        if (found != signature_cache.end())
+            return found->second;
+        return signature_cache.emplace(str, CharSignature(str)).first->second;
+    }
+
+    /**
+     * @brief Sum a kernel over the categorical attributes of two data points, on cached signatures.
+     */
+    double sum_kernel(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b,
+                      double (*kernel)(const CharSignature &, const CharSignature &))
+    {
+        // the cache is only emptied between calls, so the references of one call stay valid.
+        if (signature_cache.size() >= signature_cache_size)
+            signature_cache.clear();
+        return sum_string_distances(self, a, b, [kernel](const string &x, const string &y)
+                                    { return kernel(cached_signature(x), cached_signature(y)); });
+    }
+}
+
+double jaccard_distance(const CharSignature &a, const CharSignature &b)
+{
+    uint32_t common = intersection(a, b), all = a.size + b.size - common;
+    return all == 0 ? 0.0 : 1.0 - 1.0 * common / all;
+}
+
+double dice_distance(const CharSignature &a, const CharSignature &b)
+{
+    uint32_t common = intersection(a, b);
+    return a.size + b.size == 0 ? 0.0 : 1.0 - 2.0 * common / (a.size + b.size);
+}
+
+double overlap_distance(const CharSignature &a, const CharSignature &b)
+{
+    uint32_t common = intersection(a, b), smallest = min(a.size, b.size);
+    return smallest == 0 ? 0.0 : 1.0 - 1.0 * common / smallest;
+}
+
+double hashed_jaccard_distance(const CharSignature &a, const CharSignature &b)
+{
+    int common = 0, all = 0;
+    for (size_t i = 0; i < a.bits.size(); i++)
+    {
+        common += __builtin_popcountll(a.bits[i] & b.bits[i]);
+        all += __builtin_popcountll(a.bits[i] | b.bits[i]);
+    }
+    return all == 0 ? 0.0 : 1.0 - 1.0 * common / all;
+}
+
+double jaccard_distance_mesure(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b)
+{
+    return sum_kernel(self, a, b, jaccard_distance);
+}
+
+double dice_distance_mesure(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b)
+{
+    return sum_kernel(self, a, b, dice_distance);
+}
+
+double overlap_distance_mesure(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b)
+{
+    return sum_kernel(self, a, b, overlap_distance);
+}
+
+SignatureIndex::SignatureIndex(double (*kernel)(const CharSignature &, const CharSignature &)) : _kernel{kernel}
+{
+}
+
+void SignatureIndex::build(Dataset &dataset, double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &))
+{
+    auto keys = dataset.get_attributes();
+    auto numerics = dataset.get_numerics();
+    _attributes.clear();
+    _signatures.clear();
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] == dataset.get_label() or find(numerics.begin(), numerics.end(), keys[i]) != numerics.end())
+            continue;
+
+        _attributes.push_back(i);
+        _signatures.emplace_back();
+        for (auto &&j : dataset[keys[i]])
+        {
+            _signatures.back().emplace_back(get<string>(j));
+        }
+    }
+}
+
+vector<pair<double, int>> SignatureIndex::search(
+    Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+    double (*)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const
+{
+    vector<CharSignature> query;
+    for (auto &&i : _attributes)
+    {
+        query.emplace_back(get<string>(target[column(dataset, target, i)]));
+    }
+
+    vector<pair<double, int>> res(dataset.no_rows(), make_pair(0.0, 0));
+    for (int i = 0; i < dataset.no_rows(); i++)
+    {
+        res[i].second = i;
+    }
+
+    for (size_t j = 0; j < _attributes.size(); j++)
+    {
+        auto &signatures = _signatures[j];
+        for (size_t i = 0; i < res.size(); i++)
+        {
+            res[i].first += _kernel(signatures[i], query[j]);
+        }
+    }
+
+    k = min<size_t>(k, res.size());
+    partial_sort(res.begin(), res.begin() + k, res.end());
+    res.resize(k);
+
+    return res;
+}
+
+shared_ptr<SearchIndex> SignatureIndex::clone() const
+{
+    return make_shared<SignatureIndex>(_kernel);
+}
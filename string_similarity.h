@@ -0,0 +1,144 @@
+#ifndef H_STRING_SIMILARITY
+#define H_STRING_SIMILARITY
+/**
+ * @file string_similarity.cpp
+ * @brief Implementation of character-bag signatures and set-similarity measures over string attributes.
+ *
+ * This file contains UTF-8 decoding, the `CharSignature` type and the Jaccard, Dice and overlap kernels over it,
+ * proximity measures built on those kernels for use with `KNN::set_proximity_measure` (they cache the signatures of
+ * the values per thread, so the query side of a scan is decoded once), and the `SignatureIndex`
+ * search backend, which decodes every string value once at build time so queries only run the kernels.
+ */
+
+#include "search_index.h"
+#include <cstdint>
+#include <array>
+
+/**
+ * @brief Decode a UTF-8 string into codepoints.
+ *
+ * Invalid bytes are passed through as codepoints of their own.
+ *
+ * @param str The UTF-8 encoded string.
+ * @return The codepoints.
+ */
+u32string decode_utf8(const string &str);
+
+/**
+ * @brief Sum a distance between strings over the categorical attributes of two data points, the label excluded.
+ *
+ * Either data point may lack the label value.
+ *
+ * @param self The dataset the data points belong to.
+ * @param distance Called with the two values of every categorical attribute.
+ */
+template <typename Distance>
+double sum_string_distances(Dataset *self, const vector<Dataset::DataType> &a, const vector<Dataset::DataType> &b, Distance distance)
+{
+    auto keys = self->get_attributes();
+    size_t l = find(keys.begin(), keys.end(), self->get_label()) - keys.begin();
+    double sum = 0.0;
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (i == l)
+            continue;
+        size_t _a = (a.size() == keys.size() or i < l) ? i : i - 1,
+               _b = (b.size() == keys.size() or i < l) ? i : i - 1;
+        if (not holds_alternative<string>(a[_a]))
+            continue;
+        sum += distance(get<string>(a[_a]), get<string>(b[_b]));
+    }
+    return sum;
+}
+
+/**
+ * @brief A compact bag-of-characters signature of a string.
+ *
+ * Holds the sorted (codepoint, count) pairs of the string for exact multiset measures, and a 256-bit hashed
+ * presence set for fast approximate set measures.
+ */
+struct CharSignature
+{
+    vector<pair<char32_t, uint32_t>> counts; /**< Sorted codepoints with their number of occurrences. */
+    uint32_t size = 0;                       /**< The number of codepoints, i.e. the multiset cardinality. */
+    array<uint64_t, 4> bits{};               /**< Hashed set of the codepoints present. */
+
+    /**
+     * @brief Build the signature of a UTF-8 string.
+     *
+     * @param str The UTF-8 encoded string.
+     */
+    CharSignature(const string &str = "");
+};
+
+/**
+ * @brief Jaccard distance between the character multisets, 1 - |A ∩ B| / |A ∪ B|.
+ */
+double jaccard_distance(const CharSignature &a, const CharSignature &b);
+
+/**
+ * @brief Dice distance between the character multisets, 1 - 2|A ∩ B| / (|A| + |B|).
+ */
+double dice_distance(const CharSignature &a, const CharSignature &b);
+
+/**
+ * @brief Overlap distance between the character multisets, 1 - |A ∩ B| / min(|A|, |B|).
+ */
+double overlap_distance(const CharSignature &a, const CharSignature &b);
+
+/**
+ * @brief Approximate Jaccard distance between the hashed character sets, computed with popcounts.
+ *
+ * Ignores repeated characters and may overestimate the similarity on hash collisions.
+ */
+double hashed_jaccard_distance(const CharSignature &a, const CharSignature &b);
+
+/**
+ * @brief Sum of the character Jaccard distances over the categorical attributes, the label excluded.
+ */
+double jaccard_distance_mesure(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &);
+
+/**
+ * @brief Sum of the character Dice distances over the categorical attributes, the label excluded.
+ */
+double dice_distance_mesure(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &);
+
+/**
+ * @brief Sum of the character overlap distances over the categorical attributes, the label excluded.
+ */
+double overlap_distance_mesure(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &);
+
+/**
+ * @brief A brute-force search backend over precomputed character signatures.
+ *
+ * At build time every categorical attribute value, the label excluded, is decoded once into a `CharSignature`.
+ * A query computes its own signatures once and scores every row with the kernel, summed over the attributes.
+ * Pair it with the matching proximity measure (e.g. `jaccard_distance` with `jaccard_distance_mesure`) so that
+ * rows inserted since the last compaction are scored the same way.
+ */
+class SignatureIndex : public SearchIndex
+{
+public:
+    /**
+     * @brief Constructs a signature index.
+     *
+     * @param kernel The distance between two signatures (default is Jaccard).
+     */
+    SignatureIndex(double (*kernel)(const CharSignature &, const CharSignature &) = jaccard_distance);
+
+    void build(Dataset &dataset, double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) override;
+
+    vector<pair<double, int>> search(
+        Dataset &dataset, const vector<Dataset::DataType> &target, unsigned int k,
+        double (*proximity_measure)(Dataset *, const vector<Dataset::DataType> &, const vector<Dataset::DataType> &)) const override;
+
+    shared_ptr<SearchIndex> clone() const override;
+
+private:
+    double (*_kernel)(const CharSignature &, const CharSignature &); /**< The distance between two signatures. */
+    vector<int> _attributes;                                         /**< The positions of the indexed attributes. */
+    vector<vector<CharSignature>> _signatures;                       /**< The signatures, per attribute and then per row. */
+};
+
+#endif